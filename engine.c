@@ -0,0 +1,2064 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <assert.h>
+#include "engine.h"
+
+// Value of each kind of piece (the king is never captured, so it is not counted).
+static const int pieceValues[6] = { 0, 900, 500, 330, 320, 100 }; // K, Q, R, B, N, P
+
+// Bonus for each kind of piece being on each square, from the "Simplified Evaluation Function".
+// The tables are from white's point of view, as the board looks from white's side, so the first
+// row of each table is row 7 (black's back rank).
+static const int pieceSquareValues[6][64] =
+{
+	{ // king
+		-30,-40,-40,-50,-50,-40,-40,-30,
+		-30,-40,-40,-50,-50,-40,-40,-30,
+		-30,-40,-40,-50,-50,-40,-40,-30,
+		-30,-40,-40,-50,-50,-40,-40,-30,
+		-20,-30,-30,-40,-40,-30,-30,-20,
+		-10,-20,-20,-20,-20,-20,-20,-10,
+		 20, 20,  0,  0,  0,  0, 20, 20,
+		 20, 30, 10,  0,  0, 10, 30, 20,
+	},
+	{ // queen
+		-20,-10,-10, -5, -5,-10,-10,-20,
+		-10,  0,  0,  0,  0,  0,  0,-10,
+		-10,  0,  5,  5,  5,  5,  0,-10,
+		 -5,  0,  5,  5,  5,  5,  0, -5,
+		  0,  0,  5,  5,  5,  5,  0, -5,
+		-10,  5,  5,  5,  5,  5,  0,-10,
+		-10,  0,  5,  0,  0,  0,  0,-10,
+		-20,-10,-10, -5, -5,-10,-10,-20,
+	},
+	{ // rook
+		  0,  0,  0,  0,  0,  0,  0,  0,
+		  5, 10, 10, 10, 10, 10, 10,  5,
+		 -5,  0,  0,  0,  0,  0,  0, -5,
+		 -5,  0,  0,  0,  0,  0,  0, -5,
+		 -5,  0,  0,  0,  0,  0,  0, -5,
+		 -5,  0,  0,  0,  0,  0,  0, -5,
+		 -5,  0,  0,  0,  0,  0,  0, -5,
+		  0,  0,  0,  5,  5,  0,  0,  0,
+	},
+	{ // bishop
+		-20,-10,-10,-10,-10,-10,-10,-20,
+		-10,  0,  0,  0,  0,  0,  0,-10,
+		-10,  0,  5, 10, 10,  5,  0,-10,
+		-10,  5,  5, 10, 10,  5,  5,-10,
+		-10,  0, 10, 10, 10, 10,  0,-10,
+		-10, 10, 10, 10, 10, 10, 10,-10,
+		-10,  5,  0,  0,  0,  0,  5,-10,
+		-20,-10,-10,-10,-10,-10,-10,-20,
+	},
+	{ // knight
+		-50,-40,-30,-30,-30,-30,-40,-50,
+		-40,-20,  0,  0,  0,  0,-20,-40,
+		-30,  0, 10, 15, 15, 10,  0,-30,
+		-30,  5, 15, 20, 20, 15,  5,-30,
+		-30,  0, 15, 20, 20, 15,  0,-30,
+		-30,  5, 10, 15, 15, 10,  5,-30,
+		-40,-20,  0,  5,  5,  0,-20,-40,
+		-50,-40,-30,-30,-30,-30,-40,-50,
+	},
+	{ // pawn
+		  0,  0,  0,  0,  0,  0,  0,  0,
+		 50, 50, 50, 50, 50, 50, 50, 50,
+		 10, 10, 20, 30, 30, 20, 10, 10,
+		  5,  5, 10, 25, 25, 10,  5,  5,
+		  0,  0,  0, 20, 20,  0,  0,  0,
+		  5, -5,-10,  0,  0,-10, -5,  5,
+		  5, 10, 10,-20,-20, 10, 10,  5,
+		  0,  0,  0,  0,  0,  0,  0,  0,
+	},
+};
+
+// The transposition table, which is kept from one search to the next.
+static EngineHashTable hashTable;
+
+// Number of threads for each search (see EngineSetThreadCount).
+static int threadCount = 1;
+
+// Get the current time in seconds.
+double EngineSeconds(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Score a position without searching: the material and where the pieces are.
+// Returns: the score for the team to move.
+int NormalChessEvaluate(const NormalChess *chess)
+{
+	assert(chess);
+	int score = 0;
+	for (int k = 0; k < 12; k++)
+	{
+		int isWhite = (k < BLACK_KING);
+		int kind = k % 6;
+		for (Bitboard b = chess->board.bbPieces[k]; b; b &= b - 1)
+		{
+			int square = BitboardFirstSquare(b);
+			// Flip the square for white, because the tables have row 7 first.
+			int value = pieceValues[kind] + pieceSquareValues[kind][isWhite? square ^ 56 : square];
+			score += isWhite? value : -value;
+		}
+	}
+	return (NormalChessCurrentKing(chess) == WHITE_KING)? score : -score;
+}
+
+// Set the size of the transposition table in megabytes (rounded down to a power of 2 number of
+// buckets), which also clears it. A size of 0 frees the table.
+void EngineHashResize(int megabytes)
+{
+	free(hashTable.buckets);
+	hashTable.buckets = NULL;
+	hashTable.mask = 0;
+	if (megabytes <= 0)
+	{
+		return;
+	}
+	uint64_t count = 1;
+	while (count * 2 * sizeof(EngineHashBucket) <= (uint64_t)megabytes << 20)
+	{
+		count *= 2;
+	}
+	void *buckets;
+	if (posix_memalign(&buckets, sizeof(EngineHashBucket), count * sizeof(EngineHashBucket)))
+	{
+		assert(0 && "could not allocate the transposition table");
+		return;
+	}
+	hashTable.buckets = buckets;
+	hashTable.mask = count - 1;
+	EngineHashClear();
+}
+
+// Forget all of the positions in the transposition table (such as for a new game).
+void EngineHashClear(void)
+{
+	if (hashTable.buckets)
+	{
+		memset(hashTable.buckets, 0, (hashTable.mask + 1) * sizeof(EngineHashBucket));
+	}
+	hashTable.age = 0;
+}
+
+// Start loading the bucket for a position into the cache, so that it is ready by the time that the
+// position is searched.
+void EngineHashPrefetch(uint64_t key)
+{
+	__builtin_prefetch(&hashTable.buckets[key & hashTable.mask]);
+}
+
+// Mate scores are saved in the table as the distance to the mate from the position, instead of
+// from the root of the search, because the position can be reached at different plies.
+int EngineHashScoreTo(int score, int ply)
+{
+	if (score >= ENGINE_MATE_SCORE - ENGINE_MAX_PLY)
+	{
+		return score + ply;
+	}
+	if (score <= -ENGINE_MATE_SCORE + ENGINE_MAX_PLY)
+	{
+		return score - ply;
+	}
+	return score;
+}
+
+// Inverse of EngineHashScoreTo.
+int EngineHashScoreFrom(int score, int ply)
+{
+	if (score >= ENGINE_MATE_SCORE - ENGINE_MAX_PLY)
+	{
+		return score - ply;
+	}
+	if (score <= -ENGINE_MATE_SCORE + ENGINE_MAX_PLY)
+	{
+		return score + ply;
+	}
+	return score;
+}
+
+// Pack a transposition table entry into 64 bits: the move is bits 0-15, the score is bits 16-31,
+// the depth is bits 32-39, the bound is bits 40-47, and the age is bits 48-55.
+uint64_t EngineHashPack(const EngineHashEntry *entry)
+{
+	return (uint64_t)entry->move
+		| ((uint64_t)(uint16_t)entry->score << 16)
+		| ((uint64_t)(uint8_t)entry->depth << 32)
+		| ((uint64_t)entry->bound << 40)
+		| ((uint64_t)entry->age << 48);
+}
+
+// Inverse of EngineHashPack.
+void EngineHashUnpack(uint64_t data, EngineHashEntry *entry)
+{
+	entry->move = (NormalChessMove)data;
+	entry->score = (int16_t)(uint16_t)(data >> 16);
+	entry->depth = (int8_t)(uint8_t)(data >> 32);
+	entry->bound = (uint8_t)(data >> 40);
+	entry->age = (uint8_t)(data >> 48);
+}
+
+// Read a slot of the transposition table, which other threads may be writing to at the same time.
+// Returns: 1 if the slot has the entry for the position with the key (copied to entry), otherwise
+// 0 (and the entry is still filled in with what is in the slot).
+int EngineHashReadSlot(EngineHashSlot *slot, uint64_t key, EngineHashEntry *entry)
+{
+	uint64_t check = __atomic_load_n(&slot->check, __ATOMIC_RELAXED);
+	uint64_t data = __atomic_load_n(&slot->data, __ATOMIC_RELAXED);
+	EngineHashUnpack(data, entry);
+	return (check ^ data) == key && entry->bound != HB_NONE;
+}
+
+// Look up a position in the transposition table.
+// Returns: 1 if the position was found and copied to entry, otherwise 0.
+int EngineHashProbe(uint64_t key, EngineHashEntry *entry)
+{
+	EngineHashBucket *bucket = &hashTable.buckets[key & hashTable.mask];
+	for (int i = 0; i < ENGINE_HASH_BUCKET_SIZE; i++)
+	{
+		EngineHashEntry found;
+		if (EngineHashReadSlot(&bucket->slots[i], key, &found))
+		{
+			*entry = found;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Save the result of searching a position in the transposition table. If the bucket is full, the
+// slot replaced is the one from the oldest search and then with the least depth, because it is
+// the least likely to be useful again.
+void EngineHashStore(uint64_t key, int depth, EngineHashBound bound, int score,
+		NormalChessMove move)
+{
+	EngineHashBucket *bucket = &hashTable.buckets[key & hashTable.mask];
+	EngineHashSlot *replace = &bucket->slots[0];
+	int replaceWorth = 1 << 30;
+	int isSamePosition = 0;
+	EngineHashEntry old;
+	for (int i = 0; i < ENGINE_HASH_BUCKET_SIZE; i++)
+	{
+		EngineHashEntry entry;
+		isSamePosition = EngineHashReadSlot(&bucket->slots[i], key, &entry);
+		if (isSamePosition || entry.bound == HB_NONE)
+		{
+			replace = &bucket->slots[i];
+			old = entry;
+			break;
+		}
+		int age = (uint8_t)(hashTable.age - entry.age);
+		int worth = entry.depth - 8 * age;
+		if (worth < replaceWorth)
+		{
+			replace = &bucket->slots[i];
+			replaceWorth = worth;
+		}
+	}
+	if (isSamePosition)
+	{
+		// Keep the deeper result for the same position from this search, unless it is a bound
+		// and the new one is exact. The best move is kept if there is no new one.
+		if (old.age == hashTable.age && old.depth > depth && bound != HB_EXACT)
+		{
+			return;
+		}
+		if (move == NORMAL_CHESS_NO_MOVE)
+		{
+			move = old.move;
+		}
+	}
+	EngineHashEntry entry =
+	{
+		.move = move,
+		.score = score,
+		.depth = depth,
+		.bound = bound,
+		.age = hashTable.age,
+	};
+	uint64_t data = EngineHashPack(&entry);
+	__atomic_store_n(&replace->check, key ^ data, __ATOMIC_RELAXED);
+	__atomic_store_n(&replace->data, data, __ATOMIC_RELAXED);
+}
+
+int EngineIsInCheck(const NormalChess *chess)
+{
+	NormalChessKind king = NormalChessCurrentKing(chess);
+	int enemy = NormalChessTeamIndex(NormalChessEnemyKingKind(king));
+	return (chess->board.bbPieces[king] & chess->bbAttacks[enemy]) != 0;
+}
+
+// Check if the search has reached one of its limits. The time is only checked every so often,
+// because getting the time is slow compared to searching one position. Only the main thread checks
+// the limits (so the node limit is for the nodes of the main thread), and the helper threads keep
+// going until the main thread is done.
+int EngineShouldStop(EngineSearch *search)
+{
+	if (search->isStopped)
+	{
+		return 1;
+	}
+	EngineShared *shared = search->shared;
+	const NormalChessSearchLimits *limits = &shared->limits;
+	if (search->threadIndex > 0)
+	{
+		search->isStopped = __atomic_load_n(&shared->isStopped, __ATOMIC_RELAXED);
+	}
+	else if (shared->worker && (search->nodes & 1023) == 0
+			&& !EngineQueueIsEmpty(&shared->worker->commands))
+	{
+		EngineQueue *commands = &shared->worker->commands;
+		if (shared->isPondering && EngineQueuePeek(commands)->kind == EM_PONDER_HIT)
+		{
+			// The expected reply was played, so the search is now for real. Keep the search
+			// going, and count the time spent pondering towards the time limit (so if the
+			// opponent took longer than the limit to move, the move is ready right away).
+			EngineMessage command;
+			EngineQueuePop(commands, &command);
+			shared->isPondering = 0;
+		}
+		else
+		{
+			// A new command for the engine thread (stop, or a search of something else).
+			search->isStopped = 1;
+		}
+	}
+	else if (shared->isPondering)
+	{
+		// No limits while pondering.
+	}
+	else if (limits->nodes > 0 && search->nodes >= limits->nodes)
+	{
+		search->isStopped = 1;
+	}
+	else if (shared->hardSeconds > 0 && (search->nodes & 1023) == 0
+			&& EngineSeconds() - shared->startSeconds >= shared->hardSeconds)
+	{
+		search->isStopped = 1;
+	}
+	return search->isStopped;
+}
+
+// Order for capturing each kind of piece, or capturing with it (see EngineScoreMoves).
+static const int orderValues[6] = { 6, 5, 4, 3, 2, 1 }; // K, Q, R, B, N, P
+
+// Give each move a score for how likely it is to be good, because searching good moves first lets
+// alpha-beta skip more of the other moves. From best to worst:
+// * the best move from the transposition table
+// * captures, with the most valuable victim first and then the least valuable attacker first
+//   (MVV-LVA), and queen promotions
+// * the killer moves: quiet moves which caused a beta cutoff at the same ply in another position
+// * the other quiet moves, by how often they have caused beta cutoffs anywhere (history)
+void EngineScoreMoves(const EngineSearch *search, const NormalChess *chess,
+		const NormalChessMove *moves, int *scores, int count, NormalChessMove hashMove, int ply)
+{
+	int team = NormalChessTeamIndex(NormalChessCurrentKing(chess));
+	for (int i = 0; i < count; i++)
+	{
+		NormalChessMove m = moves[i];
+		int flags = NormalChessMoveFlags(m);
+		int subject = NormalChessMoveSubject(m);
+		int target = NormalChessMoveTarget(m);
+		if (m == hashMove)
+		{
+			scores[i] = ENGINE_ORDER_HASH_MOVE;
+		}
+		else if (flags & MF_CAPTURE)
+		{
+			// En passant is the only capture with nothing on the target square.
+			int victim = NormalChessBoardKindAt(&chess->board, target / 8, target % 8);
+			int victimValue = (victim >= 0)? orderValues[victim % 6] : orderValues[WHITE_PAWN];
+			int attacker = NormalChessBoardKindAt(&chess->board, subject / 8, subject % 8);
+			scores[i] = ENGINE_ORDER_CAPTURE + victimValue * 8 - orderValues[attacker % 6];
+		}
+		else if ((flags & MF_PROMOTE_QUEEN) == MF_PROMOTE_QUEEN)
+		{
+			scores[i] = ENGINE_ORDER_CAPTURE;
+		}
+		else if (m == search->killers[ply][0])
+		{
+			scores[i] = ENGINE_ORDER_KILLER + 1;
+		}
+		else if (m == search->killers[ply][1])
+		{
+			scores[i] = ENGINE_ORDER_KILLER;
+		}
+		else
+		{
+			scores[i] = search->history[team][subject][target];
+		}
+	}
+}
+
+// Find the move with the best score out of the moves from index i onwards, and swap it to index i.
+// This is quicker than sorting all of the moves, because a cutoff usually happens after searching
+// only a few moves.
+// Returns: the move.
+NormalChessMove EnginePickMove(NormalChessMove *moves, int *scores, int count, int i)
+{
+	int best = i;
+	for (int j = i + 1; j < count; j++)
+	{
+		if (scores[j] > scores[best])
+		{
+			best = j;
+		}
+	}
+	NormalChessMove move = moves[best];
+	int score = scores[best];
+	moves[best] = moves[i];
+	scores[best] = scores[i];
+	moves[i] = move;
+	scores[i] = score;
+	return move;
+}
+
+// Remember a quiet move which caused a beta cutoff, to search it earlier in other positions.
+void EngineUpdateQuietCutoff(EngineSearch *search, const NormalChess *chess, NormalChessMove move,
+		int depth, int ply)
+{
+	if (search->killers[ply][0] != move)
+	{
+		search->killers[ply][1] = search->killers[ply][0];
+		search->killers[ply][0] = move;
+	}
+	int team = NormalChessTeamIndex(NormalChessCurrentKing(chess));
+	int subject = NormalChessMoveSubject(move);
+	int target = NormalChessMoveTarget(move);
+	int *history = &search->history[team][subject][target];
+	*history += depth * depth;
+	if (*history >= ENGINE_HISTORY_MAX)
+	{
+		// Keep the history below the killer moves, and let newer cutoffs count for more.
+		for (int t = 0; t < 2; t++)
+		{
+			for (int s = 0; s < 64; s++)
+			{
+				for (int u = 0; u < 64; u++)
+				{
+					search->history[t][s][u] /= 2;
+				}
+			}
+		}
+	}
+}
+
+// Work out what a capture wins or loses in material if both teams keep capturing on the target
+// square, each with its least valuable piece, and each stopping when capturing again would lose
+// material. Pieces which are behind another piece along the same line join in when the piece in
+// front of them has captured. Pins are not taken into account.
+// Returns: the change in material for the team making the capture.
+int EngineStaticExchange(const NormalChess *chess, NormalChessMove move)
+{
+	// Same as pieceValues, except that the king can only be the last piece to capture.
+	static const int exchangeValues[6] = { 20000, 900, 500, 330, 320, 100 }; // K, Q, R, B, N, P
+	const NormalChessBoard *board = &chess->board;
+	int subject = NormalChessMoveSubject(move);
+	int target = NormalChessMoveTarget(move);
+	Bitboard occupied = NormalChessBoardOccupied(board);
+	int attacker = NormalChessBoardKindAt(board, subject / 8, subject % 8);
+	int victim = NormalChessBoardKindAt(board, target / 8, target % 8);
+	if (NormalChessMoveFlags(move) == MF_EN_PASSANT)
+	{
+		int object = NormalChessMoveObjectSquare(move);
+		victim = NormalChessBoardKindAt(board, object / 8, object % 8);
+		occupied &= ~(((Bitboard)1) << object);
+	}
+	assert(attacker >= 0 && victim >= 0);
+	// gain[d] is what the team making capture number d gets if the other team does not capture
+	// back.
+	int gain[32];
+	int d = 0;
+	gain[0] = exchangeValues[victim % 6];
+	int onTarget = exchangeValues[attacker % 6];
+	occupied &= ~(((Bitboard)1) << subject);
+	NormalChessKind team = NormalChessEnemyKingKind(attacker);
+	for (;;)
+	{
+		Bitboard attackers = NormalChessBoardAttackersOf(board, team, target, occupied) & occupied;
+		if (!attackers)
+		{
+			break;
+		}
+		// Find the least valuable attacker (the kinds go from the king to the pawn).
+		int kind = NormalChessKindForTeam(WHITE_PAWN, team);
+		while (!(attackers & board->bbPieces[kind]))
+		{
+			kind--;
+		}
+		Bitboard candidates = attackers & board->bbPieces[kind];
+		Bitboard from = candidates & -candidates;
+		if (kind == (int)NormalChessKingKind(team)
+				&& (NormalChessBoardAttackersOf(board, NormalChessEnemyKingKind(team), target,
+						occupied ^ from) & (occupied ^ from)))
+		{
+			// The king cannot capture a defended piece.
+			break;
+		}
+		d++;
+		gain[d] = onTarget - gain[d - 1];
+		int bestSoFar = (-gain[d - 1] > gain[d])? -gain[d - 1] : gain[d];
+		if (bestSoFar < 0)
+		{
+			// Neither team can do better by going on.
+			break;
+		}
+		onTarget = exchangeValues[kind % 6];
+		occupied ^= from;
+		team = NormalChessEnemyKingKind(team);
+	}
+	// Go back through the captures: each team only captures if it gains by it.
+	while (d > 0)
+	{
+		int keepGoing = gain[d];
+		int stop = -gain[d - 1];
+		gain[d - 1] = -((keepGoing > stop)? keepGoing : stop);
+		d--;
+	}
+	return gain[0];
+}
+
+// Get a move picker ready for a position. The quiescence search only wants the captures and queen
+// promotions, and not the captures which lose material, unless it is in check.
+void EnginePickerInit(EngineMovePicker *picker, const EngineSearch *search,
+		const NormalChess *chess, NormalChessMove hashMove, int ply, int isNoisyOnly)
+{
+	picker->stage = PS_HASH_MOVE;
+	picker->isNoisyOnly = isNoisyOnly;
+	// The quiescence search can go past ENGINE_MAX_PLY in check, but there are no killers there.
+	picker->ply = (ply < ENGINE_MAX_PLY)? ply : ENGINE_MAX_PLY;
+	NormalChessGetCheckInfo(chess, &picker->info);
+	picker->hashMove = hashMove;
+	picker->killers[0] = search->killers[picker->ply][0];
+	picker->killers[1] = search->killers[picker->ply][1];
+	picker->killerIndex = 0;
+	picker->count = 0;
+	picker->next = 0;
+	picker->badCount = 0;
+}
+
+// Pick the next move to search, doing as little work as possible before the move: the hash move
+// is checked without generating any moves, and the quiet moves are only generated once the noisy
+// moves and the killer moves have been searched without a cutoff.
+// Returns: the move, or NORMAL_CHESS_NO_MOVE if there are no moves left.
+NormalChessMove EnginePickerNext(EngineMovePicker *picker, const EngineSearch *search,
+		const NormalChess *chess)
+{
+	NormalChessMove move;
+	if (picker->stage == PS_HASH_MOVE)
+	{
+		picker->stage = PS_GENERATE_NOISY;
+		move = picker->hashMove;
+		if (move != NORMAL_CHESS_NO_MOVE && NormalChessMoveIsPseudoLegal(chess, move)
+				&& NormalChessMoveIsLegalWith(chess, &picker->info, move))
+		{
+			return move;
+		}
+	}
+	if (picker->stage == PS_GENERATE_NOISY)
+	{
+		picker->count = NormalChessGenerateMoveSet(chess, MS_NOISY, ~((Bitboard)0),
+				picker->moves);
+		if (picker->isNoisyOnly)
+		{
+			// Only keep the captures and queen promotions.
+			int kept = 0;
+			for (int i = 0; i < picker->count; i++)
+			{
+				int flags = NormalChessMoveFlags(picker->moves[i]);
+				if ((flags & MF_CAPTURE) || (flags & MF_PROMOTE_QUEEN) == MF_PROMOTE_QUEEN)
+				{
+					picker->moves[kept++] = picker->moves[i];
+				}
+			}
+			picker->count = kept;
+		}
+		EngineScoreMoves(search, chess, picker->moves, picker->scores, picker->count,
+				NORMAL_CHESS_NO_MOVE, picker->ply);
+		picker->stage = PS_GOOD_NOISY;
+	}
+	if (picker->stage == PS_GOOD_NOISY)
+	{
+		while (picker->next < picker->count)
+		{
+			move = EnginePickMove(picker->moves, picker->scores, picker->count, picker->next++);
+			if (move == picker->hashMove || !NormalChessMoveIsLegalWith(chess, &picker->info, move))
+			{
+				continue;
+			}
+			int isPlainCapture =
+					(NormalChessMoveFlags(move) & (MF_CAPTURE | MF_PROMOTE)) == MF_CAPTURE;
+			if (isPlainCapture && EngineStaticExchange(chess, move) < 0)
+			{
+				// Save the losing capture for after the quiet moves (in the slots of the moves
+				// that were already picked), or skip it in the quiescence search.
+				if (!picker->isNoisyOnly)
+				{
+					picker->moves[picker->badCount++] = move;
+				}
+				continue;
+			}
+			return move;
+		}
+		picker->stage = picker->isNoisyOnly? PS_DONE : PS_KILLERS;
+	}
+	if (picker->stage == PS_KILLERS)
+	{
+		while (picker->killerIndex < 2)
+		{
+			// The killer moves are from other positions, so they might not be quiet moves here.
+			move = picker->killers[picker->killerIndex++];
+			if (move != NORMAL_CHESS_NO_MOVE && move != picker->hashMove
+					&& !(NormalChessMoveFlags(move) & (MF_CAPTURE | MF_PROMOTE))
+					&& NormalChessMoveIsPseudoLegal(chess, move)
+					&& NormalChessMoveIsLegalWith(chess, &picker->info, move))
+			{
+				return move;
+			}
+		}
+		picker->stage = PS_GENERATE_QUIETS;
+	}
+	if (picker->stage == PS_GENERATE_QUIETS)
+	{
+		int quietCount = NormalChessGenerateMoveSet(chess, MS_QUIET, ~((Bitboard)0),
+				&picker->moves[picker->count]);
+		EngineScoreMoves(search, chess, &picker->moves[picker->count],
+				&picker->scores[picker->count], quietCount, NORMAL_CHESS_NO_MOVE, picker->ply);
+		picker->next = picker->count;
+		picker->count += quietCount;
+		picker->stage = PS_QUIETS;
+	}
+	if (picker->stage == PS_QUIETS)
+	{
+		while (picker->next < picker->count)
+		{
+			move = EnginePickMove(picker->moves, picker->scores, picker->count, picker->next++);
+			if (move != picker->hashMove && move != picker->killers[0]
+					&& move != picker->killers[1]
+					&& NormalChessMoveIsLegalWith(chess, &picker->info, move))
+			{
+				return move;
+			}
+		}
+		picker->next = 0;
+		picker->stage = PS_BAD_NOISY;
+	}
+	if (picker->stage == PS_BAD_NOISY)
+	{
+		if (picker->next < picker->badCount)
+		{
+			return picker->moves[picker->next++];
+		}
+		picker->stage = PS_DONE;
+	}
+	return NORMAL_CHESS_NO_MOVE;
+}
+
+// Search only the captures (and queen promotions) from a position, until there are none left that
+// are worth trying, so that the score is not from the middle of an exchange of pieces. The team to
+// move can also "stand pat" and not capture anything, unless it is in check (and then every move is
+// searched, to find checkmates).
+// Returns: the score for the team to move (or 0 if the search was stopped).
+int EngineQuiescence(EngineSearch *search, NormalChess *chess, int ply, int alpha, int beta)
+{
+	if (EngineShouldStop(search))
+	{
+		return 0;
+	}
+	search->nodes++;
+	int isInCheck = EngineIsInCheck(chess);
+	int best = -ENGINE_INFINITE_SCORE;
+	if (!isInCheck)
+	{
+		best = NormalChessEvaluate(chess);
+		if (best >= beta || ply >= ENGINE_MAX_PLY)
+		{
+			return best;
+		}
+		if (best > alpha)
+		{
+			alpha = best;
+		}
+	}
+	// In check, every move is searched, to find checkmates.
+	EngineMovePicker picker;
+	EnginePickerInit(&picker, search, chess, NORMAL_CHESS_NO_MOVE, ply, !isInCheck);
+	int moveCount = 0;
+	NormalChessMove move;
+	while ((move = EnginePickerNext(&picker, search, chess)) != NORMAL_CHESS_NO_MOVE)
+	{
+		moveCount++;
+		NormalChessUndo undo;
+		NormalChessMakeMove(chess, move, &undo);
+		EngineHashPrefetch(chess->key);
+		int score = -EngineQuiescence(search, chess, ply + 1, -beta, -alpha);
+		NormalChessUnmakeMove(chess, move, &undo);
+		if (search->isStopped)
+		{
+			return 0;
+		}
+		if (score > best)
+		{
+			best = score;
+		}
+		if (score > alpha)
+		{
+			alpha = score;
+		}
+		if (alpha >= beta)
+		{
+			break;
+		}
+	}
+	if (moveCount == 0 && isInCheck)
+	{
+		return -ENGINE_MATE_SCORE + ply;
+	}
+	return best;
+}
+
+// Search the moves from a position to some depth, with alpha-beta pruning: alpha is the score that
+// the team to move is already sure to get, and beta is the score that the other team will not allow
+// it to go above.
+// Returns: the score for the team to move (or 0 if the search was stopped).
+int EngineNegamax(EngineSearch *search, NormalChess *chess, int depth, int ply, int alpha, int beta)
+{
+	if (depth <= 0 || ply >= ENGINE_MAX_PLY)
+	{
+		return EngineQuiescence(search, chess, ply, alpha, beta);
+	}
+	if (EngineShouldStop(search))
+	{
+		return 0;
+	}
+	search->nodes++;
+	// Use the saved result for the position if it was searched deep enough, and otherwise search
+	// its best move first.
+	EngineHashEntry entry = { .move = NORMAL_CHESS_NO_MOVE };
+	if (EngineHashProbe(chess->key, &entry) && entry.depth >= depth)
+	{
+		int score = EngineHashScoreFrom(entry.score, ply);
+		if (entry.bound == HB_EXACT
+				|| (entry.bound == HB_LOWER && score >= beta)
+				|| (entry.bound == HB_UPPER && score <= alpha))
+		{
+			return score;
+		}
+	}
+	if (chess->halfMoveClock >= 100)
+	{
+		// Draw by the fifty move rule, unless it is checkmate.
+		NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+		int isMate = EngineIsInCheck(chess) && !NormalChessGenerateLegalMoves(chess, moves);
+		return isMate? -ENGINE_MATE_SCORE + ply : 0;
+	}
+	EngineMovePicker picker;
+	EnginePickerInit(&picker, search, chess, entry.move, ply, 0);
+	int alphaOriginal = alpha;
+	int best = -ENGINE_INFINITE_SCORE;
+	NormalChessMove bestMove = NORMAL_CHESS_NO_MOVE;
+	int moveCount = 0;
+	NormalChessMove move;
+	while ((move = EnginePickerNext(&picker, search, chess)) != NORMAL_CHESS_NO_MOVE)
+	{
+		moveCount++;
+		NormalChessUndo undo;
+		NormalChessMakeMove(chess, move, &undo);
+		EngineHashPrefetch(chess->key);
+		int score = -EngineNegamax(search, chess, depth - 1, ply + 1, -beta, -alpha);
+		NormalChessUnmakeMove(chess, move, &undo);
+		if (search->isStopped)
+		{
+			return 0;
+		}
+		if (score > best)
+		{
+			best = score;
+			bestMove = move;
+		}
+		if (score > alpha)
+		{
+			alpha = score;
+		}
+		if (alpha >= beta)
+		{
+			// The other team will avoid this position, so the rest of the moves do not matter.
+			if (!(NormalChessMoveFlags(move) & (MF_CAPTURE | MF_PROMOTE)))
+			{
+				EngineUpdateQuietCutoff(search, chess, move, depth, ply);
+			}
+			break;
+		}
+	}
+	if (moveCount == 0)
+	{
+		// Checkmate or stalemate.
+		return (picker.info.checkers != 0)? -ENGINE_MATE_SCORE + ply : 0;
+	}
+	EngineHashBound bound = HB_EXACT;
+	if (best >= beta)
+	{
+		bound = HB_LOWER;
+	}
+	else if (best <= alphaOriginal)
+	{
+		bound = HB_UPPER;
+		bestMove = NORMAL_CHESS_NO_MOVE; // no move was good enough to know which is best
+	}
+	EngineHashStore(chess->key, depth, bound, EngineHashScoreTo(best, ply), bestMove);
+	return best;
+}
+
+// Search each of the moves at the root of the search tree.
+// Returns: the best score (or 0 if the search was stopped), and the index of the best move through
+// bestIndex.
+int EngineSearchRoot(EngineSearch *search, NormalChess *chess, NormalChessMove *moves, int count,
+		int depth, int *bestIndex)
+{
+	int alpha = -ENGINE_INFINITE_SCORE;
+	*bestIndex = 0;
+	for (int i = 0; i < count; i++)
+	{
+		NormalChessUndo undo;
+		NormalChessMakeMove(chess, moves[i], &undo);
+		EngineHashPrefetch(chess->key);
+		int score = -EngineNegamax(search, chess, depth - 1, 1, -ENGINE_INFINITE_SCORE, -alpha);
+		NormalChessUnmakeMove(chess, moves[i], &undo);
+		if (search->isStopped)
+		{
+			return 0;
+		}
+		if (score > alpha)
+		{
+			alpha = score;
+			*bestIndex = i;
+		}
+	}
+	return alpha;
+}
+
+// How much to stretch the soft time limit by, for the number of depths in a row that the best move
+// has stayed the same (see EngineIterate).
+static const double stabilityScales[6] = { 2.0, 1.5, 1.2, 1.0, 0.8, 0.6 };
+
+// The time manager: decide how long to search for. With a clock, the time is shared out between
+// the moves that are likely to be left in the game. The soft limit is the time that a search
+// should usually take, and a deeper search is not started after it (see EngineIterate). The hard
+// limit is the time that a search must stop at, which is a few times the soft limit for when the
+// best move keeps changing, but never so much that the clock could run out. Without a clock, both
+// limits are just the set time (and 0 for no limit).
+void EngineAllocateTime(const NormalChessSearchLimits *limits, int moveNumber,
+		double *softSeconds, double *hardSeconds)
+{
+	assert(limits);
+	assert(softSeconds);
+	assert(hardSeconds);
+	*softSeconds = 0;
+	*hardSeconds = limits->seconds;
+	if (limits->clockSeconds <= 0)
+	{
+		return;
+	}
+	// Keep some time back for the delay before the clock stops, unless there is hardly any left.
+	double available = limits->clockSeconds - ENGINE_CLOCK_MARGIN_SECONDS;
+	if (available < limits->clockSeconds / 4)
+	{
+		available = limits->clockSeconds / 4;
+	}
+	// Expect about 40 more moves at the start of the game, and at least 20 more later on.
+	int movesLeft = 40 - moveNumber / 2;
+	if (movesLeft < 20)
+	{
+		movesLeft = 20;
+	}
+	double soft = available / movesLeft + limits->incrementSeconds * 3 / 4;
+	double hard = soft * 3;
+	if (hard > available / 2)
+	{
+		hard = available / 2;
+	}
+	if (limits->seconds > 0 && hard > limits->seconds)
+	{
+		hard = limits->seconds;
+	}
+	*softSeconds = (soft < hard)? soft : hard;
+	*hardSeconds = hard;
+}
+
+// Set how many threads search at the same time (from 1 to ENGINE_MAX_THREADS).
+// With more than one thread, the search is "Lazy SMP": every thread searches the same position,
+// and they help each other by sharing the transposition table. Half of the helper threads search
+// one ply deeper than the others, so that the threads are not all doing the same thing.
+void EngineSetThreadCount(int count)
+{
+	threadCount = (count < 1)? 1 : (count > ENGINE_MAX_THREADS)? ENGINE_MAX_THREADS : count;
+}
+
+// Get the line of moves that the search expects after a first move, by following the best moves
+// saved in the transposition table (until there is no move saved, the line gets too long, or a
+// position repeats).
+// Returns: the number of moves put in line, including the first move.
+int EngineHashLine(const NormalChess *chess, NormalChessMove first, NormalChessMove *line)
+{
+	assert(chess);
+	assert(first != NORMAL_CHESS_NO_MOVE);
+	NormalChess position = *chess;
+	uint64_t keys[ENGINE_MAX_LINE_LENGTH + 1] = { chess->key };
+	NormalChessMove move = first;
+	int length = 0;
+	while (move != NORMAL_CHESS_NO_MOVE && length < ENGINE_MAX_LINE_LENGTH)
+	{
+		NormalChessUndo undo;
+		NormalChessMakeMove(&position, move, &undo);
+		line[length++] = move;
+		keys[length] = position.key;
+		for (int i = 0; i < length; i++)
+		{
+			if (keys[i] == position.key)
+			{
+				return length;
+			}
+		}
+		// The entry could be for a different position with the same key bits, so the move is
+		// only used if it is legal.
+		move = NORMAL_CHESS_NO_MOVE;
+		EngineHashEntry entry;
+		if (EngineHashProbe(position.key, &entry))
+		{
+			NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+			int count = NormalChessGenerateLegalMoves(&position, moves);
+			for (int i = 0; i < count; i++)
+			{
+				if (moves[i] == entry.move)
+				{
+					move = entry.move;
+					break;
+				}
+			}
+		}
+	}
+	return length;
+}
+
+// Get the root of a search ready: sort the legal moves for the first depth, and have a move ready
+// in search->result even if the first depth does not finish.
+// Returns: the number of legal moves (and if there are none, the result is already final).
+int EngineRootStart(EngineSearch *search, EngineRoot *root)
+{
+	const NormalChessSearchLimits *limits = &search->shared->limits;
+	NormalChessSearchResult *result = &search->result;
+	*result = (NormalChessSearchResult){ .move = NORMAL_CHESS_NO_MOVE };
+	// Each search has its own copy of the position.
+	root->position = search->shared->position;
+	root->count = NormalChessGenerateLegalMoves(&root->position, root->moves);
+	if (root->count == 0)
+	{
+		result->score = EngineIsInCheck(&root->position)? -ENGINE_MATE_SCORE : 0;
+		return 0;
+	}
+	int scores[NORMAL_CHESS_MAX_MOVES];
+	EngineScoreMoves(search, &root->position, root->moves, scores, root->count,
+			NORMAL_CHESS_NO_MOVE, 0);
+	for (int i = 0; i < root->count; i++)
+	{
+		EnginePickMove(root->moves, scores, root->count, i);
+	}
+	result->move = root->moves[0];
+	root->maxDepth = ENGINE_MAX_PLY;
+	if (limits->depth > 0 && limits->depth < root->maxDepth)
+	{
+		root->maxDepth = limits->depth;
+	}
+	root->lineCount = (limits->lines > 1)? limits->lines : 1;
+	if (root->lineCount > ENGINE_MAX_LINES)
+	{
+		root->lineCount = ENGINE_MAX_LINES;
+	}
+	if (root->lineCount > root->count)
+	{
+		root->lineCount = root->count;
+	}
+	root->stableDepths = 0;
+	return root->count;
+}
+
+// Move the best move found for a line (out of the moves from that line on) to the front of the
+// rest, keeping the order of the others.
+void EngineRootPutFirst(EngineRoot *root, int line, int bestIndex)
+{
+	NormalChessMove best = root->moves[line + bestIndex];
+	memmove(&root->moves[line + 1], &root->moves[line], bestIndex * sizeof(*root->moves));
+	root->moves[line] = best;
+}
+
+// Save the result of a depth that was finished (and send it to the game, on the engine thread).
+// Returns: 1 if a deeper search should not be started, or 0 if it should.
+int EngineRootFinishDepth(EngineSearch *search, EngineRoot *root, int depth, const int *lineScores)
+{
+	EngineShared *shared = search->shared;
+	NormalChessSearchResult *result = &search->result;
+	int isHelper = (search->threadIndex > 0);
+	NormalChessMove best = root->moves[0];
+	int score = lineScores[0];
+	root->stableDepths = (depth > 1 && best == result->move)? root->stableDepths + 1 : 0;
+	result->move = best;
+	result->score = score;
+	result->depth = depth;
+	result->lineCount = root->lineCount;
+	for (int line = 0; line < root->lineCount; line++)
+	{
+		NormalChessSearchLine *l = &result->lines[line];
+		l->score = lineScores[line];
+		l->length = EngineHashLine(&root->position, root->moves[line], l->moves);
+	}
+	if (!isHelper && shared->worker
+			&& EngineQueueCount(&shared->worker->results) < ENGINE_QUEUE_LENGTH - 1)
+	{
+		// Let the game know how the search is going (but always leave room in the queue for the
+		// final result).
+		EngineMessage info = { .kind = EM_INFO, .id = shared->id, .result = *result };
+		info.result.nodes = search->nodes;
+		info.result.seconds = EngineSeconds() - shared->startSeconds;
+		EngineQueuePush(&shared->worker->results, &info);
+	}
+	if (depth >= root->maxDepth)
+	{
+		return 1;
+	}
+	// Searching deeper will not change anything if there is only one move, or if a checkmate has
+	// been found within the depth (but a ponder search has to wait for the ponder hit).
+	int isDone = (root->count == 1 || score >= ENGINE_MATE_SCORE - depth
+			|| score <= -ENGINE_MATE_SCORE + depth);
+	if (isDone && !isHelper && !shared->isPondering)
+	{
+		return 1;
+	}
+	// Do not start a deeper search if it would probably not finish within the soft time limit
+	// (each depth usually takes about as long as all of the depths before it). The limit is
+	// stretched while the best move keeps changing, and shrunk once it has stayed the same for a
+	// few depths, because then a deeper search is unlikely to change it.
+	if (!isHelper && !shared->isPondering && shared->softSeconds > 0)
+	{
+		int i = (root->stableDepths < 5)? root->stableDepths : 5;
+		double seconds = EngineSeconds() - shared->startSeconds;
+		if (seconds * 2 >= shared->softSeconds * stabilityScales[i])
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Search the root position one ply deeper at a time until one of the limits is reached (or until
+// the main thread is done, for a helper thread), and put the result in search->result. The result
+// is from the deepest search that was finished, and the best move from each search is searched
+// first in the next one.
+void EngineIterate(EngineSearch *search)
+{
+	EngineRoot root;
+	if (!EngineRootStart(search, &root))
+	{
+		return;
+	}
+	for (int depth = 1 + (search->threadIndex % 2); depth <= root.maxDepth; depth++)
+	{
+		// Find the best move, then the best move out of the rest, and so on for each line.
+		int lineScores[ENGINE_MAX_LINES];
+		for (int line = 0; line < root.lineCount && !search->isStopped; line++)
+		{
+			int bestIndex;
+			lineScores[line] = EngineSearchRoot(search, &root.position, &root.moves[line],
+					root.count - line, depth, &bestIndex);
+			EngineRootPutFirst(&root, line, bestIndex);
+		}
+		if (search->isStopped || EngineRootFinishDepth(search, &root, depth, lineScores))
+		{
+			break;
+		}
+	}
+}
+
+// Thread function for a helper thread (see EngineSetThreadCount).
+void *EngineThread(void *arg)
+{
+	EngineIterate(arg);
+	return NULL;
+}
+
+// Find the best move for the team to move, searching until one of the limits is reached.
+NormalChessSearchResult NormalChessSearch(const NormalChess *chess, NormalChessSearchLimits limits)
+{
+	assert(limits.depth > 0 || limits.nodes > 0 || limits.seconds > 0 || limits.clockSeconds > 0);
+	return EngineSearchPosition(chess, limits, NULL, 0, 0);
+}
+
+// Search like NormalChessSearch. On the engine thread (if worker is not NULL), the search also
+// stops when a command is sent to the engine thread, and an EM_INFO message with the given id is
+// sent after each depth. A ponder search does not use the time and node limits until an
+// EM_PONDER_HIT command is sent.
+NormalChessSearchResult EngineSearchPosition(const NormalChess *chess,
+		NormalChessSearchLimits limits, EngineWorker *worker, int id, int isPondering)
+{
+	assert(chess);
+	assert(limits.depth > 0 || limits.nodes > 0 || limits.seconds > 0 || limits.clockSeconds > 0
+			|| worker);
+	assert(worker || !isPondering);
+	if (!hashTable.buckets)
+	{
+		EngineHashResize(ENGINE_DEFAULT_HASH_MEGABYTES);
+	}
+	hashTable.age++;
+	EngineShared shared = { .limits = limits, .startSeconds = EngineSeconds(), .position = *chess,
+			.worker = worker, .id = id, .isPondering = isPondering };
+	EngineAllocateTime(&limits, chess->turn / 2 + 1, &shared.softSeconds, &shared.hardSeconds);
+	// The search state is big (because of the history table), so it is not kept on the stack.
+	EngineSearch *searches = calloc(threadCount, sizeof(*searches));
+	assert(searches);
+	pthread_t threads[ENGINE_MAX_THREADS];
+	for (int i = 0; i < threadCount; i++)
+	{
+		searches[i].shared = &shared;
+		searches[i].threadIndex = i;
+	}
+	for (int i = 1; i < threadCount; i++)
+	{
+		pthread_create(&threads[i], NULL, EngineThread, &searches[i]);
+	}
+	EngineIterate(&searches[0]);
+	__atomic_store_n(&shared.isStopped, 1, __ATOMIC_RELAXED);
+	for (int i = 1; i < threadCount; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+	// Use the result of the main thread, unless a helper thread finished a deeper search.
+	NormalChessSearchResult result = searches[0].result;
+	long long nodes = 0;
+	for (int i = 0; i < threadCount; i++)
+	{
+		if (searches[i].result.depth > result.depth)
+		{
+			result = searches[i].result;
+		}
+		nodes += searches[i].nodes;
+	}
+	result.nodes = nodes;
+	result.seconds = EngineSeconds() - shared.startSeconds;
+	free(searches);
+	// Guess the reply to the best move from the transposition table, for pondering.
+	result.ponder = NORMAL_CHESS_NO_MOVE;
+	NormalChessMove line[ENGINE_MAX_LINE_LENGTH];
+	if (result.move != NORMAL_CHESS_NO_MOVE && EngineHashLine(chess, result.move, line) > 1)
+	{
+		result.ponder = line[1];
+	}
+	return result;
+}
+
+// Start a search that runs in slices on the calling thread (see EngineSliceRun). Only the limits
+// that NormalChessSearch uses apply, and the search is on one thread.
+// Returns: the search, to free with EngineSliceFree.
+EngineSlicedSearch *EngineSliceStart(const NormalChess *chess, NormalChessSearchLimits limits)
+{
+	assert(chess);
+	assert(limits.depth > 0 || limits.nodes > 0 || limits.seconds > 0 || limits.clockSeconds > 0
+			|| limits.lines > 0);
+	if (!hashTable.buckets)
+	{
+		EngineHashResize(ENGINE_DEFAULT_HASH_MEGABYTES);
+	}
+	hashTable.age++;
+	EngineSlicedSearch *sliced = calloc(1, sizeof(*sliced));
+	assert(sliced);
+	sliced->shared = (EngineShared){ .limits = limits, .startSeconds = EngineSeconds(),
+			.position = *chess };
+	EngineAllocateTime(&limits, chess->turn / 2 + 1, &sliced->shared.softSeconds,
+			&sliced->shared.hardSeconds);
+	sliced->search.shared = &sliced->shared;
+	if (!EngineRootStart(&sliced->search, &sliced->root))
+	{
+		sliced->isDone = 1;
+		return sliced;
+	}
+	sliced->depth = 1;
+	EngineSliceStartLine(sliced);
+	return sliced;
+}
+
+// Free a search from EngineSliceStart, which does not have to be done (or do nothing for NULL).
+void EngineSliceFree(EngineSlicedSearch *sliced)
+{
+	free(sliced);
+}
+
+// Start searching the moves of the root position for the current line and depth.
+void EngineSliceStartLine(EngineSlicedSearch *sliced)
+{
+	EngineFrame *frame = &sliced->frames[0];
+	frame->depth = sliced->depth;
+	frame->isQuiescence = 0;
+	frame->alpha = -ENGINE_INFINITE_SCORE;
+	frame->beta = ENGINE_INFINITE_SCORE;
+	frame->bestIndex = 0;
+	frame->isEntered = 1;
+	frame->count = sliced->root.count - sliced->line;
+	frame->next = 0;
+	sliced->ply = 0;
+}
+
+// Save the score of the line that was just searched, and start on the next line or depth (like
+// EngineIterate).
+void EngineSliceFinishLine(EngineSlicedSearch *sliced)
+{
+	EngineFrame *frame = &sliced->frames[0];
+	sliced->lineScores[sliced->line] = frame->alpha;
+	EngineRootPutFirst(&sliced->root, sliced->line, frame->bestIndex);
+	sliced->line++;
+	if (sliced->line < sliced->root.lineCount)
+	{
+		EngineSliceStartLine(sliced);
+		return;
+	}
+	if (EngineRootFinishDepth(&sliced->search, &sliced->root, sliced->depth, sliced->lineScores))
+	{
+		sliced->isDone = 1;
+		return;
+	}
+	sliced->depth++;
+	sliced->line = 0;
+	EngineSliceStartLine(sliced);
+}
+
+// Look at the position at the top of the stack, like the start of EngineNegamax (or
+// EngineQuiescence), and get its move picker ready. The only difference is that the quiescence
+// search also stops in check at ENGINE_MAX_PLY, because there is no room left on the stack.
+// Returns: 1 if the score is already known without searching the moves (and then it is given
+// through score), or 0 if the moves have to be searched.
+int EngineSliceEnter(EngineSlicedSearch *sliced, EngineFrame *frame, int *score)
+{
+	EngineSearch *search = &sliced->search;
+	NormalChess *chess = &sliced->root.position;
+	int ply = sliced->ply;
+	frame->isEntered = 1;
+	frame->isQuiescence = (frame->depth <= 0 || ply >= ENGINE_MAX_PLY);
+	*score = 0;
+	if (EngineShouldStop(search))
+	{
+		return 1;
+	}
+	search->nodes++;
+	frame->alphaOriginal = frame->alpha;
+	frame->best = -ENGINE_INFINITE_SCORE;
+	frame->bestMove = NORMAL_CHESS_NO_MOVE;
+	frame->moveCount = 0;
+	if (frame->isQuiescence)
+	{
+		frame->isInCheck = EngineIsInCheck(chess);
+		if (!frame->isInCheck)
+		{
+			frame->best = NormalChessEvaluate(chess);
+			if (frame->best >= frame->beta || ply >= ENGINE_MAX_PLY)
+			{
+				*score = frame->best;
+				return 1;
+			}
+			if (frame->best > frame->alpha)
+			{
+				frame->alpha = frame->best;
+			}
+		}
+		else if (ply >= ENGINE_MAX_PLY)
+		{
+			*score = NormalChessEvaluate(chess);
+			return 1;
+		}
+		EnginePickerInit(&frame->picker, search, chess, NORMAL_CHESS_NO_MOVE, ply,
+				!frame->isInCheck);
+		return 0;
+	}
+	EngineHashEntry entry = { .move = NORMAL_CHESS_NO_MOVE };
+	if (EngineHashProbe(chess->key, &entry) && entry.depth >= frame->depth)
+	{
+		int hashScore = EngineHashScoreFrom(entry.score, ply);
+		if (entry.bound == HB_EXACT
+				|| (entry.bound == HB_LOWER && hashScore >= frame->beta)
+				|| (entry.bound == HB_UPPER && hashScore <= frame->alpha))
+		{
+			*score = hashScore;
+			return 1;
+		}
+	}
+	if (chess->halfMoveClock >= 100)
+	{
+		// Draw by the fifty move rule, unless it is checkmate.
+		NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+		int isMate = EngineIsInCheck(chess) && !NormalChessGenerateLegalMoves(chess, moves);
+		*score = isMate? -ENGINE_MATE_SCORE + ply : 0;
+		return 1;
+	}
+	EnginePickerInit(&frame->picker, search, chess, entry.move, ply, 0);
+	return 0;
+}
+
+// Make the next move to search from the position at the top of the stack, and push a frame for
+// the position after it.
+// Returns: 1 if a move was made, or 0 if there are no moves left to search.
+int EngineSliceNextMove(EngineSlicedSearch *sliced, EngineFrame *frame)
+{
+	NormalChess *chess = &sliced->root.position;
+	NormalChessMove move;
+	if (sliced->ply == 0)
+	{
+		if (frame->next >= frame->count)
+		{
+			return 0;
+		}
+		move = sliced->root.moves[sliced->line + frame->next++];
+	}
+	else
+	{
+		move = EnginePickerNext(&frame->picker, &sliced->search, chess);
+		if (move == NORMAL_CHESS_NO_MOVE)
+		{
+			return 0;
+		}
+		frame->moveCount++;
+	}
+	assert(sliced->ply < ENGINE_MAX_PLY);
+	frame->move = move;
+	NormalChessMakeMove(chess, move, &frame->undo);
+	EngineHashPrefetch(chess->key);
+	EngineFrame *child = &sliced->frames[++sliced->ply];
+	child->depth = frame->isQuiescence? 0 : frame->depth - 1;
+	child->alpha = -frame->beta;
+	child->beta = -frame->alpha;
+	child->isEntered = 0;
+	return 1;
+}
+
+// Finish with the position at the top of the stack once its moves have been searched (or once
+// there are none), like the end of EngineNegamax (or EngineQuiescence).
+// Returns: the score for the team to move.
+int EngineSliceLeave(EngineSlicedSearch *sliced, EngineFrame *frame)
+{
+	int ply = sliced->ply;
+	if (frame->isQuiescence)
+	{
+		return (frame->moveCount == 0 && frame->isInCheck)? -ENGINE_MATE_SCORE + ply : frame->best;
+	}
+	if (frame->moveCount == 0)
+	{
+		// Checkmate or stalemate.
+		return (frame->picker.info.checkers != 0)? -ENGINE_MATE_SCORE + ply : 0;
+	}
+	EngineHashBound bound = HB_EXACT;
+	NormalChessMove bestMove = frame->bestMove;
+	if (frame->best >= frame->beta)
+	{
+		bound = HB_LOWER;
+	}
+	else if (frame->best <= frame->alphaOriginal)
+	{
+		bound = HB_UPPER;
+		bestMove = NORMAL_CHESS_NO_MOVE; // no move was good enough to know which is best
+	}
+	EngineHashStore(sliced->root.position.key, frame->depth, bound,
+			EngineHashScoreTo(frame->best, ply), bestMove);
+	return frame->best;
+}
+
+// Pop the frame at the top of the stack, and give its score to the frame below it (like returning
+// from EngineNegamax or EngineQuiescence).
+void EngineSliceReturn(EngineSlicedSearch *sliced, int score)
+{
+	EngineSearch *search = &sliced->search;
+	NormalChess *chess = &sliced->root.position;
+	assert(sliced->ply > 0);
+	EngineFrame *frame = &sliced->frames[--sliced->ply];
+	NormalChessUnmakeMove(chess, frame->move, &frame->undo);
+	if (search->isStopped)
+	{
+		// The unfinished depth is thrown away, like in EngineIterate.
+		sliced->isDone = 1;
+		return;
+	}
+	score = -score;
+	if (sliced->ply == 0)
+	{
+		if (score > frame->alpha)
+		{
+			frame->alpha = score;
+			frame->bestIndex = frame->next - 1;
+		}
+		return;
+	}
+	if (score > frame->best)
+	{
+		frame->best = score;
+		frame->bestMove = frame->move;
+	}
+	if (score > frame->alpha)
+	{
+		frame->alpha = score;
+	}
+	if (frame->alpha >= frame->beta)
+	{
+		// The other team will avoid this position, so the rest of the moves do not matter.
+		if (!frame->isQuiescence
+				&& !(NormalChessMoveFlags(frame->move) & (MF_CAPTURE | MF_PROMOTE)))
+		{
+			EngineUpdateQuietCutoff(search, chess, frame->move, frame->depth, sliced->ply);
+		}
+		frame->picker.stage = PS_DONE;
+	}
+}
+
+// Go on with a sliced search until it has looked at the given number of positions, or until the
+// given number of seconds has passed (0 for no limit on either, but one of them must be set). The
+// search is only paused before it looks at a new position, so nothing has to be done again when
+// it goes on. The limits of the search itself still apply, and the time for them counts from
+// EngineSliceStart.
+// Returns: 1 if the search is done, or 0 if there is more to do.
+int EngineSliceRun(EngineSlicedSearch *sliced, long long nodes, double seconds)
+{
+	assert(sliced);
+	assert(nodes > 0 || seconds > 0);
+	EngineSearch *search = &sliced->search;
+	long long stopNodes = search->nodes + nodes;
+	double stopSeconds = EngineSeconds() + seconds;
+	int entered = 0;
+	while (!sliced->isDone)
+	{
+		EngineFrame *frame = &sliced->frames[sliced->ply];
+		if (!frame->isEntered)
+		{
+			// Getting the time is slow compared to a node, so it is only checked every so often.
+			if ((nodes > 0 && search->nodes >= stopNodes)
+					|| (seconds > 0 && (++entered & 15) == 0 && EngineSeconds() >= stopSeconds))
+			{
+				break;
+			}
+			int score;
+			if (EngineSliceEnter(sliced, frame, &score))
+			{
+				EngineSliceReturn(sliced, score);
+			}
+		}
+		else if (EngineSliceNextMove(sliced, frame))
+		{
+			// Go on with the new position at the top of the stack.
+		}
+		else if (sliced->ply == 0)
+		{
+			EngineSliceFinishLine(sliced);
+		}
+		else
+		{
+			EngineSliceReturn(sliced, EngineSliceLeave(sliced, frame));
+		}
+	}
+	search->result.nodes = search->nodes;
+	search->result.seconds = EngineSeconds() - sliced->shared.startSeconds;
+	return sliced->isDone;
+}
+
+// Get the result of a sliced search so far, which is from the deepest search finished (or just the
+// first move to try, before the first depth is finished).
+NormalChessSearchResult EngineSliceResult(const EngineSlicedSearch *sliced)
+{
+	assert(sliced);
+	NormalChessSearchResult result = sliced->search.result;
+	result.ponder = NORMAL_CHESS_NO_MOVE;
+	NormalChessMove line[ENGINE_MAX_LINE_LENGTH];
+	if (result.move != NORMAL_CHESS_NO_MOVE
+			&& EngineHashLine(&sliced->shared.position, result.move, line) > 1)
+	{
+		result.ponder = line[1];
+	}
+	return result;
+}
+
+// Put a copy of a message at the end of a queue (only from the writing thread).
+// Returns: 1 if successful, or 0 if the queue is full.
+int EngineQueuePush(EngineQueue *queue, const EngineMessage *message)
+{
+	unsigned tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+	unsigned head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+	if (tail - head == ENGINE_QUEUE_LENGTH)
+	{
+		return 0;
+	}
+	queue->messages[tail % ENGINE_QUEUE_LENGTH] = *message;
+	__atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+// Take the message at the front of a queue (only from the reading thread).
+// Returns: 1 if successful, or 0 if the queue is empty.
+int EngineQueuePop(EngineQueue *queue, EngineMessage *message)
+{
+	unsigned head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+	unsigned tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+	if (head == tail)
+	{
+		return 0;
+	}
+	*message = queue->messages[head % ENGINE_QUEUE_LENGTH];
+	__atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+// Get the message at the front of a queue without taking it out (only from the reading thread).
+// Returns: the message, or NULL if the queue is empty.
+const EngineMessage *EngineQueuePeek(EngineQueue *queue)
+{
+	unsigned head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+	unsigned tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+	if (head == tail)
+	{
+		return NULL;
+	}
+	return &queue->messages[head % ENGINE_QUEUE_LENGTH];
+}
+
+// Count the messages in a queue (from either thread, but it may change right away).
+int EngineQueueCount(EngineQueue *queue)
+{
+	unsigned tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+	unsigned head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+	return (int)(tail - head);
+}
+
+// Check if a queue has no messages in it (only from the reading thread).
+int EngineQueueIsEmpty(EngineQueue *queue)
+{
+	return __atomic_load_n(&queue->head, __ATOMIC_RELAXED)
+			== __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+}
+
+// Check if the game has sent a command which replaces the last search (anything but EM_STOP or
+// EM_PONDER_HIT), which means that it will not wait for the result of that search any more (only
+// from the engine thread).
+int EngineWorkerHasNewCommand(EngineWorker *worker)
+{
+	EngineQueue *queue = &worker->commands;
+	unsigned head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+	unsigned tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+	for (unsigned i = head; i != tail; i++)
+	{
+		EngineMessageKind kind = queue->messages[i % ENGINE_QUEUE_LENGTH].kind;
+		if (kind != EM_STOP && kind != EM_PONDER_HIT)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Thread function for the engine thread: run the commands from the game until told to quit.
+void *EngineWorkerThread(void *arg)
+{
+	EngineWorker *worker = arg;
+	for (;;)
+	{
+		EngineMessage command;
+		if (!EngineQueuePop(&worker->commands, &command))
+		{
+			// Nothing to do, so wait a little instead of spinning (the game only checks for
+			// results once per frame anyways).
+			struct timespec wait = { .tv_nsec = 1000000 };
+			nanosleep(&wait, NULL);
+			continue;
+		}
+		switch (command.kind)
+		{
+			case EM_SEARCH:
+			case EM_PONDER:
+			{
+				EngineMessage reply = { .kind = EM_BEST_MOVE, .id = command.id };
+				reply.result = EngineSearchPosition(&command.position, command.limits, worker,
+						command.id, command.kind == EM_PONDER);
+				// The game may be waiting for this, so it must not be lost. The queue can be full
+				// of messages from earlier searches if the game has not checked for results for a
+				// while, so wait until the game makes room, unless it has moved on to something
+				// else and will not want this result any more.
+				while (!EngineWorkerHasNewCommand(worker)
+						&& !EngineQueuePush(&worker->results, &reply))
+				{
+					struct timespec wait = { .tv_nsec = 1000000 };
+					nanosleep(&wait, NULL);
+				}
+				break;
+			}
+			case EM_STOP:
+			case EM_PONDER_HIT:
+				// Any search has already been stopped by this command arriving (or a ponder search
+				// finished before the ponder hit, and its result has already been sent).
+				break;
+			case EM_CLEAR:
+				EngineHashClear();
+				break;
+			case EM_QUIT:
+				return NULL;
+			default:
+				assert(0 && "invalid command for the engine thread");
+		}
+	}
+}
+
+// Start the engine thread.
+EngineWorker *EngineWorkerStart(void)
+{
+	EngineWorker *worker = calloc(1, sizeof(*worker));
+	assert(worker);
+	int status = pthread_create(&worker->thread, NULL, EngineWorkerThread, worker);
+	assert(status == 0);
+	(void)status;
+	return worker;
+}
+
+// Stop any search, end the engine thread and free it.
+void EngineWorkerQuit(EngineWorker *worker)
+{
+	assert(worker);
+	EngineMessage command = { .kind = EM_QUIT };
+	while (!EngineQueuePush(&worker->commands, &command))
+	{
+		struct timespec wait = { .tv_nsec = 1000000 };
+		nanosleep(&wait, NULL);
+	}
+	pthread_join(worker->thread, NULL);
+	free(worker);
+}
+
+// Start a search on the engine thread (stopping any search that is running), without waiting.
+// If the engine thread is pondering this position (the expected reply was played), the ponder
+// search just keeps going instead, now with the limits that were given to EngineWorkerPonder.
+// Returns: the id of the search to give to EngineWorkerPoll, or 0 if the engine thread is too
+// busy to take the command right now (and it should be tried again later).
+int EngineWorkerSearch(EngineWorker *worker, const NormalChess *chess,
+		NormalChessSearchLimits limits)
+{
+	assert(worker);
+	assert(chess);
+	if (worker->ponderId && worker->ponderKey == chess->key)
+	{
+		EngineMessage command = { .kind = EM_PONDER_HIT };
+		if (!EngineQueuePush(&worker->commands, &command))
+		{
+			return 0;
+		}
+		int id = worker->ponderId;
+		worker->ponderId = 0;
+		return id;
+	}
+	EngineMessage command = { .kind = EM_SEARCH, .id = worker->lastId + 1, .position = *chess,
+			.limits = limits };
+	if (!EngineQueuePush(&worker->commands, &command))
+	{
+		return 0;
+	}
+	// A ponder miss: the new search stops the ponder search, and its result is thrown away.
+	worker->ponderId = 0;
+	worker->lastId = command.id;
+	return command.id;
+}
+
+// Start analyzing a position on the engine thread: find the best few moves, and keep searching
+// deeper until stopped. Use EngineWorkerPoll to get the lines found so far after each depth.
+// Returns: the id of the search, or 0 if the engine thread is too busy to take the command right
+// now (and it should be tried again later).
+int EngineWorkerAnalyze(EngineWorker *worker, const NormalChess *chess, int lines)
+{
+	assert(worker);
+	assert(chess);
+	assert(lines >= 1 && lines <= ENGINE_MAX_LINES);
+	// Always a new search, even if the position is being pondered.
+	worker->ponderId = 0;
+	return EngineWorkerSearch(worker, chess, (NormalChessSearchLimits){ .lines = lines });
+}
+
+// Start searching on the engine thread for the next move, while the opponent is thinking about
+// what to play in the position. The search assumes that the opponent will play the given move,
+// and when the position after that move is given to EngineWorkerSearch, the search is already
+// underway. If the opponent does something else, the ponder search is stopped and thrown away.
+void EngineWorkerPonder(EngineWorker *worker, const NormalChess *chess, NormalChessMove move,
+		NormalChessSearchLimits limits)
+{
+	assert(worker);
+	assert(chess);
+	assert(move != NORMAL_CHESS_NO_MOVE);
+	EngineMessage command = { .kind = EM_PONDER, .id = worker->lastId + 1, .limits = limits };
+	NormalChessMakeMoveCopy(chess, move, &command.position);
+	if (!EngineQueuePush(&worker->commands, &command))
+	{
+		// Not pondering is fine.
+		return;
+	}
+	worker->lastId = command.id;
+	worker->ponderId = command.id;
+	worker->ponderKey = command.position.key;
+}
+
+// Tell the engine thread to stop searching (or pondering). The stopped search still sends its
+// result.
+void EngineWorkerStop(EngineWorker *worker)
+{
+	assert(worker);
+	worker->ponderId = 0;
+	EngineMessage command = { .kind = EM_STOP };
+	// If the queue is full, there are already commands waiting which stop the search.
+	EngineQueuePush(&worker->commands, &command);
+}
+
+// Wait for the result of a search (for when there is nothing else to do in the meantime).
+void EngineWorkerWait(EngineWorker *worker, int id, NormalChessSearchResult *result)
+{
+	assert(id > 0);
+	while (EngineWorkerPoll(worker, id, result) != EP_DONE)
+	{
+		struct timespec wait = { .tv_nsec = 1000000 };
+		nanosleep(&wait, NULL);
+	}
+}
+
+// Have the engine thread clear the transposition table, once it is not searching (the table can
+// not be cleared from another thread while a search might be using it).
+void EngineWorkerClearHash(EngineWorker *worker)
+{
+	assert(worker);
+	EngineMessage command = { .kind = EM_CLEAR };
+	while (!EngineQueuePush(&worker->commands, &command))
+	{
+		struct timespec wait = { .tv_nsec = 1000000 };
+		nanosleep(&wait, NULL);
+	}
+}
+
+// Check how a search is going, without waiting. Messages for other searches (which were stopped
+// or replaced) are thrown away.
+// Returns: EP_DONE if the search is done (and puts the result in result), EP_PROGRESS if the search
+// is still going (and puts the latest result so far in result), or EP_NOTHING if there is no news.
+EnginePollStatus EngineWorkerPoll(EngineWorker *worker, int id, NormalChessSearchResult *result)
+{
+	assert(worker);
+	assert(result);
+	EnginePollStatus status = EP_NOTHING;
+	EngineMessage reply;
+	while (EngineQueuePop(&worker->results, &reply))
+	{
+		assert(reply.kind == EM_INFO || reply.kind == EM_BEST_MOVE);
+		if (reply.id == id)
+		{
+			*result = reply.result;
+			if (reply.kind == EM_BEST_MOVE)
+			{
+				return EP_DONE;
+			}
+			status = EP_PROGRESS;
+		}
+	}
+	return status;
+}
+
+void TestNormalChessSearch(void)
+{
+	NormalChess chess;
+	NormalChessMove move;
+	char moveStr[6];
+	int isOk;
+	// Checkmate in one move.
+	isOk = NormalChessSetUpFEN(&chess, "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1");
+	assert(isOk);
+	NormalChessSearchLimits limits = { .depth = 4 };
+	NormalChessSearchResult result = NormalChessSearch(&chess, limits);
+	NormalChessMoveToString(result.move, moveStr);
+	assert(!strcmp(moveStr, "a1a8"));
+	assert(result.score == ENGINE_MATE_SCORE - 1);
+	// Win the queen, which is not defended.
+	isOk = NormalChessSetUpFEN(&chess, "4k3/8/8/3q4/4P3/8/8/4K3 w - - 0 1");
+	assert(isOk);
+	result = NormalChessSearch(&chess, (NormalChessSearchLimits){ .depth = 3 });
+	NormalChessMoveToString(result.move, moveStr);
+	assert(!strcmp(moveStr, "e4d5"));
+	assert(result.score > 0);
+	// A node limit stops the search early, but there is still a legal move.
+	NormalChessSetUp(&chess);
+	result = NormalChessSearch(&chess, (NormalChessSearchLimits){ .nodes = 2000 });
+	assert(result.nodes <= 2000);
+	assert(NormalChessMoveIsLegal(&chess, result.move));
+	// Searching the same position again is quicker, because of the transposition table.
+	EngineHashClear();
+	limits = (NormalChessSearchLimits){ .depth = 5 };
+	NormalChessSearchResult first = NormalChessSearch(&chess, limits);
+	result = NormalChessSearch(&chess, limits);
+	assert(result.nodes < first.nodes);
+	// Static exchange: a pawn takes a knight, a rook takes a pawn defended by a pawn, and a rook
+	// takes a pawn defended by a rook with another rook behind it.
+	isOk = NormalChessSetUpFEN(&chess, "4k3/8/8/3n4/4P3/8/8/4K3 w - - 0 1");
+	assert(isOk);
+	isOk = NormalChessParseMove(&chess, "e4d5", &move);
+	assert(isOk);
+	assert(EngineStaticExchange(&chess, move) == 320);
+	isOk = NormalChessSetUpFEN(&chess, "4k3/8/2p5/3p4/8/8/3R4/4K3 w - - 0 1");
+	assert(isOk);
+	isOk = NormalChessParseMove(&chess, "d2d5", &move);
+	assert(isOk);
+	assert(EngineStaticExchange(&chess, move) == 100 - 500);
+	isOk = NormalChessSetUpFEN(&chess, "4k3/3r4/8/3p4/8/8/3R4/3RK3 w - - 0 1");
+	assert(isOk);
+	isOk = NormalChessParseMove(&chess, "d2d5", &move);
+	assert(isOk);
+	assert(EngineStaticExchange(&chess, move) == 100);
+	// The quiescence search sees that taking the pawn loses the queen, even at depth 1.
+	isOk = NormalChessSetUpFEN(&chess, "4k3/8/2p5/3p4/8/8/3Q4/4K3 w - - 0 1");
+	assert(isOk);
+	result = NormalChessSearch(&chess, (NormalChessSearchLimits){ .depth = 1 });
+	NormalChessMoveToString(result.move, moveStr);
+	assert(strcmp(moveStr, "d2d5"));
+	// No move when checkmated.
+	isOk = NormalChessSetUpFEN(&chess, "R5k1/5ppp/8/8/8/8/8/6K1 b - - 1 1");
+	assert(isOk);
+	result = NormalChessSearch(&chess, (NormalChessSearchLimits){ .depth = 2 });
+	assert(result.move == NORMAL_CHESS_NO_MOVE);
+	assert(result.score == -ENGINE_MATE_SCORE);
+	// The time manager keeps the hard limit well inside the clock, even with a big increment.
+	double soft, hard;
+	limits = (NormalChessSearchLimits){ .seconds = 2.0 };
+	EngineAllocateTime(&limits, 1, &soft, &hard);
+	assert(soft == 0 && hard == 2.0);
+	limits = (NormalChessSearchLimits){ .clockSeconds = 60.0 };
+	EngineAllocateTime(&limits, 1, &soft, &hard);
+	assert(soft > 1.0 && soft < hard && hard < 30.0);
+	limits = (NormalChessSearchLimits){ .clockSeconds = 1.0, .incrementSeconds = 5.0 };
+	EngineAllocateTime(&limits, 30, &soft, &hard);
+	assert(soft <= hard && hard < 1.0 - ENGINE_CLOCK_MARGIN_SECONDS);
+	limits = (NormalChessSearchLimits){ .clockSeconds = 0.05 };
+	EngineAllocateTime(&limits, 80, &soft, &hard);
+	assert(soft > 0 && hard < 0.05);
+	// Multi-PV: the best few moves each get a line, and the lines are legal.
+	isOk = NormalChessSetUpFEN(&chess, "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1");
+	assert(isOk);
+	result = NormalChessSearch(&chess, (NormalChessSearchLimits){ .depth = 4, .lines = 3 });
+	assert(result.lineCount == 3);
+	assert(result.lines[0].moves[0] == result.move);
+	assert(result.lines[0].score == ENGINE_MATE_SCORE - 1);
+	assert(result.lines[1].score < result.lines[0].score);
+	assert(result.lines[1].moves[0] != result.move && result.lines[2].moves[0] != result.move);
+	for (int i = 0; i < result.lineCount; i++)
+	{
+		NormalChess position = chess;
+		for (int j = 0; j < result.lines[i].length; j++)
+		{
+			NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+			int count = NormalChessGenerateLegalMoves(&position, moves);
+			int isLegal = 0;
+			for (int k = 0; k < count; k++)
+			{
+				isLegal |= (moves[k] == result.lines[i].moves[j]);
+			}
+			assert(isLegal);
+			NormalChessDoMove(&position, result.lines[i].moves[j]);
+		}
+	}
+	const char *kiwipete = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+	// The move picker gives the hash move first and then the captures, and it gives each legal
+	// move once (even if the killer moves are not legal). For the quiescence search, it only gives
+	// the 3 captures which do not lose material.
+	isOk = NormalChessSetUpFEN(&chess, kiwipete);
+	assert(isOk);
+	EngineSearch *search = calloc(1, sizeof(*search));
+	assert(search);
+	NormalChessMove hashMove;
+	isOk = NormalChessParseMove(&chess, "a2a3", &hashMove);
+	assert(isOk);
+	search->killers[1][0] = NormalChessMoveFromSquares(4, 12, MF_QUIET); // e1e2 is blocked
+	isOk = NormalChessParseMove(&chess, "e1d1", &search->killers[1][1]);
+	assert(isOk);
+	for (int noisyOnly = 0; noisyOnly < 2; noisyOnly++)
+	{
+		EngineMovePicker picker;
+		EnginePickerInit(&picker, search, &chess, noisyOnly? NORMAL_CHESS_NO_MOVE : hashMove, 1,
+				noisyOnly);
+		NormalChessMove legal[NORMAL_CHESS_MAX_MOVES];
+		int legalCount = NormalChessGenerateLegalMoves(&chess, legal);
+		int picked = 0;
+		while ((move = EnginePickerNext(&picker, search, &chess)) != NORMAL_CHESS_NO_MOVE)
+		{
+			assert(picked > 0 || noisyOnly || move == hashMove);
+			assert(picked != 1 || NormalChessMoveIsCapture(move));
+			int found = 0;
+			for (int i = 0; i < legalCount; i++)
+			{
+				found += (legal[i] == move);
+				legal[i] = (legal[i] == move)? NORMAL_CHESS_NO_MOVE : legal[i];
+			}
+			assert(found == 1);
+			picked++;
+		}
+		assert(picked == (noisyOnly? 3 : legalCount));
+	}
+	free(search);
+	// A sliced search, run a few hundred positions at a time, searches the same tree as the normal
+	// search, and it has a legal move to play at any time.
+	isOk = NormalChessSetUpFEN(&chess, kiwipete);
+	assert(isOk);
+	limits = (NormalChessSearchLimits){ .depth = 5, .lines = 2 };
+	EngineHashClear();
+	first = NormalChessSearch(&chess, limits);
+	EngineHashClear();
+	EngineSlicedSearch *sliced = EngineSliceStart(&chess, limits);
+	int slices = 1;
+	EngineSliceRun(sliced, 1, 0);
+	assert(NormalChessMoveIsLegal(&chess, EngineSliceResult(sliced).move));
+	while (!EngineSliceRun(sliced, 300, 0))
+	{
+		slices++;
+	}
+	result = EngineSliceResult(sliced);
+	EngineSliceFree(sliced);
+	assert(slices > 10);
+	assert(result.move == first.move && result.score == first.score);
+	assert(result.nodes == first.nodes && result.depth == 5);
+	assert(result.lines[1].moves[0] == first.lines[1].moves[0]);
+	assert(result.ponder == first.ponder);
+	(void)first;
+	// Several threads find the same checkmate in one.
+	EngineSetThreadCount(4);
+	isOk = NormalChessSetUpFEN(&chess, "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1");
+	assert(isOk);
+	result = NormalChessSearch(&chess, (NormalChessSearchLimits){ .depth = 4 });
+	NormalChessMoveToString(result.move, moveStr);
+	assert(!strcmp(moveStr, "a1a8"));
+	EngineSetThreadCount(1);
+	(void)isOk;
+}
+
+
+void TestEngineWorker(void)
+{
+	NormalChessSearchResult result;
+	NormalChessSearchLimits limits;
+	NormalChess chess;
+	char moveStr[6];
+	int isOk;
+	// The queue keeps the order of the messages, and it can fill up.
+	EngineQueue *queue = calloc(1, sizeof(*queue));
+	EngineMessage message = { .kind = EM_STOP };
+	int isDone;
+	for (int i = 0; i < ENGINE_QUEUE_LENGTH; i++)
+	{
+		message.id = i;
+		isDone = EngineQueuePush(queue, &message);
+		assert(isDone);
+	}
+	isDone = EngineQueuePush(queue, &message);
+	assert(!isDone);
+	for (int i = 0; i < ENGINE_QUEUE_LENGTH; i++)
+	{
+		isDone = EngineQueuePop(queue, &message);
+		assert(isDone);
+		assert(message.id == i);
+	}
+	assert(EngineQueueIsEmpty(queue));
+	isDone = EngineQueuePop(queue, &message);
+	assert(!isDone);
+	(void)isDone;
+	free(queue);
+	EngineWorker *worker = EngineWorkerStart();
+	// A search on the engine thread finds the same checkmate as a normal search.
+	isOk = NormalChessSetUpFEN(&chess, "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1");
+	assert(isOk);
+	int id = EngineWorkerSearch(worker, &chess, (NormalChessSearchLimits){ .depth = 4 });
+	assert(id > 0);
+	EngineWorkerWait(worker, id, &result);
+	NormalChessMoveToString(result.move, moveStr);
+	assert(!strcmp(moveStr, "a1a8"));
+	// A search with no limits runs until it is stopped, and still gives a legal move.
+	NormalChessSetUp(&chess);
+	id = EngineWorkerSearch(worker, &chess, (NormalChessSearchLimits){ 0 });
+	nanosleep(&(struct timespec){ .tv_nsec = 50000000 }, NULL);
+	EnginePollStatus status = EngineWorkerPoll(worker, id, &result);
+	assert(status != EP_DONE);
+	(void)status;
+	EngineWorkerStop(worker);
+	EngineWorkerWait(worker, id, &result);
+	assert(NormalChessMoveIsLegal(&chess, result.move));
+	// The result has the expected reply to ponder on.
+	limits = (NormalChessSearchLimits){ .depth = 4 };
+	EngineWorkerWait(worker, EngineWorkerSearch(worker, &chess, limits), &result);
+	assert(result.ponder != NORMAL_CHESS_NO_MOVE);
+	NormalChess next, reply;
+	NormalChessMakeMoveCopy(&chess, result.move, &next);
+	NormalChessMakeMoveCopy(&next, result.ponder, &reply);
+	// A ponder hit keeps the ponder search going.
+	EngineWorkerPonder(worker, &next, result.ponder, limits);
+	int ponderId = worker->ponderId;
+	assert(ponderId > 0);
+	id = EngineWorkerSearch(worker, &reply, limits);
+	assert(id == ponderId);
+	EngineWorkerWait(worker, ponderId, &result);
+	assert(result.depth == 4);
+	assert(NormalChessMoveIsLegal(&reply, result.move));
+	// A ponder miss starts a new search instead.
+	EngineWorkerPonder(worker, &next, result.ponder, limits);
+	ponderId = worker->ponderId;
+	assert(ponderId > 0);
+	NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+	NormalChessGenerateLegalMoves(&next, moves);
+	NormalChessMakeMoveCopy(&next, (moves[0] == result.ponder)? moves[1] : moves[0], &reply);
+	id = EngineWorkerSearch(worker, &reply, limits);
+	assert(id > 0 && id != ponderId);
+	EngineWorkerWait(worker, id, &result);
+	assert(NormalChessMoveIsLegal(&reply, result.move));
+	// The result of a search is not lost when the game has not checked for results for a while,
+	// so that the queue is full of messages from a ponder search: not after a ponder miss, and not
+	// after the ponder search is stopped first. The reply here is forced, so the search ends before
+	// the game checks for its result.
+	isOk = NormalChessSetUpFEN(&reply, "k7/8/8/8/8/8/1q6/K7 w - - 0 1");
+	assert(isOk);
+	limits = (NormalChessSearchLimits){ .seconds = 1.0 };
+	for (int isStopped = 0; isStopped < 2; isStopped++)
+	{
+		NormalChessSetUp(&chess);
+		NormalChessGenerateLegalMoves(&chess, moves);
+		EngineWorkerPonder(worker, &chess, moves[0], limits);
+		while (EngineQueueCount(&worker->results) < ENGINE_QUEUE_LENGTH - 1)
+		{
+			nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+		}
+		if (isStopped)
+		{
+			EngineWorkerStop(worker);
+		}
+		id = EngineWorkerSearch(worker, &reply, limits);
+		nanosleep(&(struct timespec){ .tv_nsec = 50000000 }, NULL);
+		EngineWorkerWait(worker, id, &result);
+		NormalChessMoveToString(result.move, moveStr);
+		assert(!strcmp(moveStr, "a1b2"));
+	}
+	// Analysis keeps sending the lines found so far until it is stopped.
+	NormalChessSetUp(&chess);
+	id = EngineWorkerAnalyze(worker, &chess, 2);
+	assert(id > 0);
+	do
+	{
+		nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+	}
+	while (EngineWorkerPoll(worker, id, &result) != EP_PROGRESS || result.depth < 3);
+	assert(result.lineCount == 2);
+	assert(result.lines[0].moves[0] != result.lines[1].moves[0]);
+	EngineWorkerStop(worker);
+	EngineWorkerWait(worker, id, &result);
+	assert(result.lineCount == 2);
+	EngineWorkerQuit(worker);
+	(void)isOk;
+}
+
+/* vi: set colorcolumn=101 textwidth=100 tabstop=4 noexpandtab: */
@@ -0,0 +1,362 @@
+#ifndef __ENGINE_H
+#define __ENGINE_H
+
+// The computer player for normal chess: a negamax alpha-beta search with iterative deepening.
+// This does not depend on the graphics or the rest of the game.
+
+#include <pthread.h>
+#include "normalchess.h"
+
+// Scores are in centipawns, from the point of view of the team to move. Being checkmated is scored
+// as -ENGINE_MATE_SCORE plus the number of plies until the mate, so that a quicker mate is better.
+#define ENGINE_MATE_SCORE 30000
+#define ENGINE_INFINITE_SCORE 32000
+
+// The deepest that the search can go (in plies).
+#define ENGINE_MAX_PLY 64
+
+// Limits on how much NormalChessSearch can do. A limit of 0 means no limit, but at least one of the
+// limits must be set (except for a search on the engine thread, which can be stopped).
+typedef struct NormalChessSearchLimits
+{
+	int depth;               // number of plies to search (at most ENGINE_MAX_PLY)
+	long long nodes;         // number of positions for the main search thread to search
+	double seconds;          // time to search for
+	double clockSeconds;     // time left on the clock, to let the time manager decide how long to
+	                         // search for (see EngineAllocateTime)
+	double incrementSeconds; // time added to the clock after each move
+	int lines;               // number of best moves to find a line for, at most ENGINE_MAX_LINES
+	                         // (0 is the same as 1)
+} NormalChessSearchLimits;
+
+// Time to keep on the clock for the delay between the search stopping and the clock stopping.
+#define ENGINE_CLOCK_MARGIN_SECONDS 0.1
+
+// Most lines that one search can find (see NormalChessSearchLimits).
+#define ENGINE_MAX_LINES 4
+
+// Most moves kept for each line.
+#define ENGINE_MAX_LINE_LENGTH 8
+
+// One of the best moves found, and the moves that are expected to follow it (the "principal
+// variation"), which are read back from the transposition table.
+typedef struct NormalChessSearchLine
+{
+	int score;  // score of the first move for the team to move
+	int length; // number of moves
+	NormalChessMove moves[ENGINE_MAX_LINE_LENGTH];
+} NormalChessSearchLine;
+
+// What NormalChessSearch found.
+typedef struct NormalChessSearchResult
+{
+	NormalChessMove move;   // best move (NORMAL_CHESS_NO_MOVE if the team to move cannot move)
+	int score;              // score of the best move for the team to move
+	int depth;              // depth of the deepest search that was finished
+	long long nodes;        // number of positions searched
+	double seconds;         // time spent
+	NormalChessMove ponder; // the expected reply to the best move (or NORMAL_CHESS_NO_MOVE)
+	int lineCount;          // number of lines found (the same as limits.lines, if there are
+	                        // enough legal moves and the first depth was finished)
+	NormalChessSearchLine lines[ENGINE_MAX_LINES]; // from the best move to the worst
+} NormalChessSearchResult;
+
+// Size of the transposition table if it is not set with EngineHashResize.
+#define ENGINE_DEFAULT_HASH_MEGABYTES 16
+
+// What kind of score a transposition table entry has. Searching with alpha-beta only gives the
+// exact score for a position if the score is between alpha and beta.
+typedef enum EngineHashBound
+{
+	HB_NONE,  // the entry is empty
+	HB_EXACT, // the score is exact
+	HB_LOWER, // the real score is at least the score (the search was cut off at beta)
+	HB_UPPER, // the real score is at most the score (no move got above alpha)
+} EngineHashBound;
+
+// One position in the transposition table (unpacked, see EngineHashSlot).
+typedef struct EngineHashEntry
+{
+	NormalChessMove move; // best move found (or NORMAL_CHESS_NO_MOVE)
+	int16_t score;        // score from the search (see EngineHashScoreFrom)
+	int8_t depth;         // depth that the position was searched to
+	uint8_t bound;        // EngineHashBound
+	uint8_t age;          // the EngineHashTable age when the entry was saved
+} EngineHashEntry;
+
+// How an EngineHashEntry is kept in the table. The entry is packed into one 64-bit data word, and
+// the check is the position key XOR'd with the data. The search threads share the table without
+// any locks, so if two threads write the same slot at the same time and the check and the data
+// end up coming from different writes, the check will not match the key and the slot is just
+// treated as empty.
+typedef struct EngineHashSlot
+{
+	uint64_t check; // key ^ data
+	uint64_t data;  // see EngineHashPack
+} EngineHashSlot;
+
+// The transposition table is split into buckets the size of a CPU cache line, so that looking up
+// a position only needs one memory access. The low bits of the key pick the bucket, and a position
+// can go in any of the slots in the bucket.
+#define ENGINE_HASH_BUCKET_SIZE 4
+typedef struct EngineHashBucket
+{
+	EngineHashSlot slots[ENGINE_HASH_BUCKET_SIZE];
+} EngineHashBucket;
+_Static_assert(sizeof(EngineHashBucket) == 64, "a bucket should fill one cache line");
+
+// The transposition table: the results of searching positions, saved to be used again when the
+// same position is reached by a different order of moves (or in the next search).
+typedef struct EngineHashTable
+{
+	EngineHashBucket *buckets; // aligned to the start of a cache line
+	uint64_t mask;             // number of buckets - 1
+	uint8_t age;               // goes up for each search, so that old entries are replaced first
+} EngineHashTable;
+
+// Move ordering scores (see EngineScoreMoves). History scores are always less than
+// ENGINE_HISTORY_MAX.
+#define ENGINE_ORDER_HASH_MOVE (1 << 30)
+#define ENGINE_ORDER_CAPTURE   (1 << 28)
+#define ENGINE_ORDER_KILLER    (1 << 27)
+#define ENGINE_HISTORY_MAX     (1 << 26)
+
+// Stages of an EngineMovePicker, in the order that they happen.
+typedef enum EnginePickStage
+{
+	PS_HASH_MOVE,       // the best move from the transposition table, before generating anything
+	PS_GENERATE_NOISY,
+	PS_GOOD_NOISY,      // captures which do not lose material, and promotions
+	PS_KILLERS,
+	PS_GENERATE_QUIETS,
+	PS_QUIETS,          // by history
+	PS_BAD_NOISY,       // captures which lose material
+	PS_DONE,
+} EnginePickStage;
+
+// Gives the legal moves of a position one at a time, from the move most likely to be best, and
+// generates the moves in stages (see EnginePickerNext). Most cutoffs happen on one of the first
+// few moves, so the quiet moves often do not need to be generated at all.
+typedef struct EngineMovePicker
+{
+	EnginePickStage stage;
+	int isNoisyOnly;             // for the quiescence search: only the good captures and promotions
+	int ply;
+	NormalChessCheckInfo info;   // for checking that the moves are legal
+	NormalChessMove hashMove;
+	NormalChessMove killers[2];
+	int killerIndex;             // index of the next killer move to try
+	NormalChessMove moves[NORMAL_CHESS_MAX_MOVES]; // noisy moves, and then quiet moves
+	int scores[NORMAL_CHESS_MAX_MOVES];
+	int count;                   // number of moves generated so far
+	int next;                    // index of the next move to pick
+	int badCount;                // number of losing captures, which are moved to the start of moves
+} EngineMovePicker;
+
+// Most threads that can search at the same time (see EngineSetThreadCount).
+#define ENGINE_MAX_THREADS 64
+
+// What a message between the game and the engine thread is for (see EngineWorker).
+typedef enum EngineMessageKind
+{
+	EM_SEARCH,     // to the engine: search the position until one of the limits is reached
+	EM_PONDER,     // to the engine: search the position (which is after the expected reply)
+	               // without using the limits until EM_PONDER_HIT
+	EM_PONDER_HIT, // to the engine: the expected reply was played, so keep searching with limits
+	EM_STOP,       // to the engine: stop searching now and send the best move found so far
+	EM_CLEAR,      // to the engine: forget the transposition table (for a new game)
+	EM_QUIT,       // to the engine: end the engine thread
+	EM_INFO,       // from the engine: the result so far of the search with the id, after each depth
+	EM_BEST_MOVE,  // from the engine: the search with the id is done
+} EngineMessageKind;
+
+typedef struct EngineMessage
+{
+	EngineMessageKind kind;
+	int id;                         // which EM_SEARCH (or EM_PONDER) a reply is for
+	NormalChess position;           // for EM_SEARCH and EM_PONDER
+	NormalChessSearchLimits limits; // for EM_SEARCH and EM_PONDER (all 0 to search until stopped)
+	NormalChessSearchResult result; // for EM_INFO and EM_BEST_MOVE
+} EngineMessage;
+
+// A queue of messages from one thread to one other thread, which does not need any locks. Only
+// the writing thread changes the tail and only the reading thread changes the head, and a message
+// is copied in (or out) before the index is moved past it.
+#define ENGINE_QUEUE_LENGTH 8
+typedef struct EngineQueue
+{
+	EngineMessage messages[ENGINE_QUEUE_LENGTH];
+	unsigned head; // count of messages taken out (atomic)
+	unsigned tail; // count of messages put in (atomic)
+} EngineQueue;
+
+// The engine thread, which runs searches for the game so that the game can keep drawing while
+// the computer is thinking. The game sends commands and polls for results every frame.
+typedef struct EngineWorker
+{
+	EngineQueue commands; // from the game to the engine thread
+	EngineQueue results;  // from the engine thread to the game
+	pthread_t thread;
+	int lastId;           // id of the last search sent
+	int ponderId;         // id of the ponder search, or 0 if not pondering
+	uint64_t ponderKey;   // key of the position that the ponder search is for
+} EngineWorker;
+
+// What EngineWorkerPoll found out about a search.
+typedef enum EnginePollStatus
+{
+	EP_NOTHING,  // nothing new yet
+	EP_PROGRESS, // the search is still going, but it has finished another depth
+	EP_DONE,     // the search is done
+} EnginePollStatus;
+
+// What the search threads share.
+typedef struct EngineShared
+{
+	NormalChessSearchLimits limits;
+	double startSeconds;
+	double softSeconds;      // time after which a deeper search is not started (0 for no limit)
+	double hardSeconds;      // time after which the search is stopped (0 for no limit)
+	NormalChess position;    // the position to search from
+	int isStopped;           // set (atomically) when the main thread is done, to stop the helpers
+	EngineWorker *worker;    // if not NULL, the engine thread that is running the search
+	int id;                  // id of the search on the engine thread
+	int isPondering;         // the limits are not used until EM_PONDER_HIT is sent
+} EngineShared;
+
+// The root of a search, for iterative deepening (see EngineIterate).
+typedef struct EngineRoot
+{
+	NormalChess position;                          // copy of the position to search from
+	NormalChessMove moves[NORMAL_CHESS_MAX_MOVES]; // the legal moves, from the best so far
+	int count;                                     // number of legal moves
+	int lineCount;                                 // number of lines to find
+	int maxDepth;
+	int stableDepths; // number of depths in a row that the best move stayed the same
+} EngineRoot;
+
+// The state of one search thread.
+typedef struct EngineSearch
+{
+	EngineShared *shared;
+	int threadIndex; // 0 for the main thread, which decides when to stop
+	NormalChessSearchResult result; // from the deepest search finished by this thread
+	long long nodes;
+	int isStopped; // set when a limit is reached, and then the unfinished search is thrown away
+	NormalChessMove killers[ENGINE_MAX_PLY + 1][2]; // the latest quiet moves to cause a cutoff
+	int history[2][64][64]; // for each team, subject square and target square: the cutoffs so far
+} EngineSearch;
+
+// One ply of a sliced search: what EngineNegamax (or EngineQuiescence) keeps in its local variables
+// while it searches the moves from a position.
+typedef struct EngineFrame
+{
+	int depth;             // plies left to search (0 or less for the quiescence search)
+	int isQuiescence;
+	int alpha;
+	int beta;
+	int alphaOriginal;
+	int best;
+	NormalChessMove bestMove;
+	int bestIndex;         // at the root: index of the best move for the line
+	int isEntered;         // the position has been looked at and the picker is ready
+	int isInCheck;
+	int count;             // at the root: number of moves for the line
+	int next;              // at the root: index of the next move to search
+	int moveCount;         // number of moves searched so far
+	NormalChessMove move;  // the move being searched now
+	NormalChessUndo undo;  // for unmaking the move
+	EngineMovePicker picker;
+} EngineFrame;
+
+// A search that runs in slices on the calling thread, for builds without an engine thread (see
+// EngineSliceRun). It searches the same tree as EngineIterate on one thread, but the tree is kept
+// in an explicit stack of frames instead of the call stack, so that it can be paused anywhere.
+typedef struct EngineSlicedSearch
+{
+	EngineShared shared;
+	EngineSearch search;
+	EngineRoot root;         // the position in root is the position at the top of the stack
+	int depth;               // depth being searched
+	int line;                // line being searched
+	int lineScores[ENGINE_MAX_LINES];
+	int ply;                 // index of the top of the stack
+	int isDone;
+	EngineFrame frames[ENGINE_MAX_PLY + 1];
+} EngineSlicedSearch;
+
+EnginePollStatus EngineWorkerPoll(EngineWorker *worker, int id, NormalChessSearchResult *result);
+EngineSlicedSearch *EngineSliceStart(const NormalChess *chess, NormalChessSearchLimits limits);
+EngineWorker *EngineWorkerStart(void);
+NormalChessMove EnginePickMove(NormalChessMove *moves, int *scores, int count, int i);
+NormalChessMove EnginePickerNext(EngineMovePicker *picker, const EngineSearch *search,
+		const NormalChess *chess);
+NormalChessSearchResult EngineSearchPosition(const NormalChess *chess,
+		NormalChessSearchLimits limits, EngineWorker *worker, int id, int isPondering);
+NormalChessSearchResult EngineSliceResult(const EngineSlicedSearch *sliced);
+NormalChessSearchResult NormalChessSearch(const NormalChess *chess, NormalChessSearchLimits limits);
+const EngineMessage *EngineQueuePeek(EngineQueue *queue);
+double EngineSeconds(void);
+int EngineHashLine(const NormalChess *chess, NormalChessMove first, NormalChessMove *line);
+int EngineHashProbe(uint64_t key, EngineHashEntry *entry);
+int EngineHashReadSlot(EngineHashSlot *slot, uint64_t key, EngineHashEntry *entry);
+int EngineHashScoreFrom(int score, int ply);
+int EngineHashScoreTo(int score, int ply);
+int EngineIsInCheck(const NormalChess *chess);
+int EngineNegamax(EngineSearch *search, NormalChess *chess, int depth, int ply, int alpha,
+		int beta);
+int EngineQueueCount(EngineQueue *queue);
+int EngineQueueIsEmpty(EngineQueue *queue);
+int EngineQueuePop(EngineQueue *queue, EngineMessage *message);
+int EngineQueuePush(EngineQueue *queue, const EngineMessage *message);
+int EngineQuiescence(EngineSearch *search, NormalChess *chess, int ply, int alpha, int beta);
+int EngineRootFinishDepth(EngineSearch *search, EngineRoot *root, int depth,
+		const int *lineScores);
+int EngineRootStart(EngineSearch *search, EngineRoot *root);
+int EngineSearchRoot(EngineSearch *search, NormalChess *chess, NormalChessMove *moves, int count,
+		int depth, int *bestIndex);
+int EngineShouldStop(EngineSearch *search);
+int EngineSliceEnter(EngineSlicedSearch *sliced, EngineFrame *frame, int *score);
+int EngineSliceLeave(EngineSlicedSearch *sliced, EngineFrame *frame);
+int EngineSliceNextMove(EngineSlicedSearch *sliced, EngineFrame *frame);
+int EngineSliceRun(EngineSlicedSearch *sliced, long long nodes, double seconds);
+int EngineStaticExchange(const NormalChess *chess, NormalChessMove move);
+int EngineWorkerAnalyze(EngineWorker *worker, const NormalChess *chess, int lines);
+int EngineWorkerHasNewCommand(EngineWorker *worker);
+int EngineWorkerSearch(EngineWorker *worker, const NormalChess *chess,
+		NormalChessSearchLimits limits);
+int NormalChessEvaluate(const NormalChess *chess);
+uint64_t EngineHashPack(const EngineHashEntry *entry);
+void *EngineThread(void *arg);
+void *EngineWorkerThread(void *arg);
+void EngineAllocateTime(const NormalChessSearchLimits *limits, int moveNumber,
+		double *softSeconds, double *hardSeconds);
+void EngineHashClear(void);
+void EngineHashPrefetch(uint64_t key);
+void EngineHashResize(int megabytes);
+void EngineHashStore(uint64_t key, int depth, EngineHashBound bound, int score,
+		NormalChessMove move);
+void EngineHashUnpack(uint64_t data, EngineHashEntry *entry);
+void EngineIterate(EngineSearch *search);
+void EnginePickerInit(EngineMovePicker *picker, const EngineSearch *search,
+		const NormalChess *chess, NormalChessMove hashMove, int ply, int isNoisyOnly);
+void EngineRootPutFirst(EngineRoot *root, int line, int bestIndex);
+void EngineScoreMoves(const EngineSearch *search, const NormalChess *chess,
+		const NormalChessMove *moves, int *scores, int count, NormalChessMove hashMove, int ply);
+void EngineSetThreadCount(int count);
+void EngineSliceFinishLine(EngineSlicedSearch *sliced);
+void EngineSliceFree(EngineSlicedSearch *sliced);
+void EngineSliceReturn(EngineSlicedSearch *sliced, int score);
+void EngineSliceStartLine(EngineSlicedSearch *sliced);
+void EngineUpdateQuietCutoff(EngineSearch *search, const NormalChess *chess, NormalChessMove move,
+		int depth, int ply);
+void EngineWorkerClearHash(EngineWorker *worker);
+void EngineWorkerPonder(EngineWorker *worker, const NormalChess *chess, NormalChessMove move,
+		NormalChessSearchLimits limits);
+void EngineWorkerQuit(EngineWorker *worker);
+void EngineWorkerStop(EngineWorker *worker);
+void EngineWorkerWait(EngineWorker *worker, int id, NormalChessSearchResult *result);
+void TestEngineWorker(void);
+void TestNormalChessSearch(void);
+
+#endif /* __ENGINE_H */
@@ -0,0 +1,18 @@
+// Engine tests: searches on one or more threads, and the engine thread. These run searches and
+// wait on threads, so they are not run every time the game starts (see Test in game.c).
+// Usage: enginetest
+
+#include <stdio.h>
+#include "engine.h"
+
+int main(void)
+{
+	BitboardInitTables();
+	NormalChessInitZobrist();
+	TestNormalChessSearch();
+	TestEngineWorker();
+	printf("engine tests passed\n");
+	return 0;
+}
+
+/* vi: set colorcolumn=101 textwidth=100 tabstop=4 noexpandtab: */
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 #include <assert.h>
 #include "raylib.h"
 #include "stb_ds.h"
@@ -10,10 +11,8 @@
 #define abs(x) (((x) > 0)? (x) : -(x))
 #define sign(x) ((x)? (((x) > 0)? 1 : -1) : 0)
 
-// TODO: add detection of game-over.
 // TODO: add animation of pieces moving.
 // TODO: add gameplay buttons to quit, resign, restart, etc..
-// TODO: add game turn timers.
 // TODO: add sound effects: checkMate, resign, game over.
 // TODO: add particles.
 
@@ -86,62 +85,6 @@ const char *GameStateToStr(GameState s)
 	}
 }
 
-const char *NormalChessKindToStr(NormalChessKind k)
-{
-	switch (k)
-	{
-		case WHITE_KING:   return "WHITE_KING";
-		case WHITE_QUEEN:  return "WHITE_QUEEN";
-		case WHITE_ROOK:   return "WHITE_ROOK";
-		case WHITE_BISHOP: return "WHITE_BISHOP";
-		case WHITE_KNIGHT: return "WHITE_KNIGHT";
-		case WHITE_PAWN:   return "WHITE_PAWN";
-		case BLACK_KING:   return "BLACK_KING";
-		case BLACK_QUEEN:  return "BLACK_QUEEN";
-		case BLACK_ROOK:   return "BLACK_ROOK";
-		case BLACK_BISHOP: return "BLACK_BISHOP";
-		case BLACK_KNIGHT: return "BLACK_KNIGHT";
-		case BLACK_PAWN:   return "BLACK_PAWN";
-		default:
-			return "(invalid NormalChessKind)";
-	}
-}
-
-// Get the king of a chess piece kind.
-NormalChessKind NormalChessKingKind(NormalChessKind k)
-{
-	switch (k)
-	{
-		case WHITE_KING:
-		case WHITE_QUEEN:
-		case WHITE_ROOK:
-		case WHITE_BISHOP:
-		case WHITE_KNIGHT:
-		case WHITE_PAWN:
-			return WHITE_KING;
-		case BLACK_KING:
-		case BLACK_QUEEN:
-		case BLACK_ROOK:
-		case BLACK_BISHOP:
-		case BLACK_KNIGHT:
-		case BLACK_PAWN:
-			return BLACK_KING;
-		default:
-			assert(0 && "invalid NormalChessKind");
-	}
-}
-
-NormalChessKind NormalChessEnemyKingKind(NormalChessKind k)
-{
-	return (NormalChessKingKind(k) == WHITE_KING)? BLACK_KING : WHITE_KING;
-}
-
-NormalChessKind PieceKingOf(const NormalChessPiece *p)
-{
-	assert(p);
-	return NormalChessKingKind(p->kind);
-}
-
 // Search dynamic array for vector2
 Vector2 *Vector2ArrFind(Vector2 *arrVectors, Vector2 val)
 {
@@ -242,26 +185,6 @@ void ClearMoveSquares(GameContext *game)
 	game->arrDraggedPieceMoves = NULL;
 }
 
-int NormalChessTeamEq(NormalChessKind a, NormalChessKind b)
-{
-	return NormalChessKingKind(a) == NormalChessKingKind(b);
-}
-
-int NormalChessPieceTeamEq(const NormalChessPiece *a, const NormalChessPiece *b)
-{
-	return a && b && NormalChessTeamEq(a->kind, b->kind);
-}
-
-NormalChessKind NormalChessCurrentKing(const NormalChess *chess)
-{
-	return (chess->turn % 2 == 0)? WHITE_KING : BLACK_KING;
-}
-
-int NormalChessCanUsePiece(const NormalChess *chess, const NormalChessPiece *p)
-{
-	return chess && p && NormalChessTeamEq(p->kind, NormalChessCurrentKing(chess));
-}
-
 // Convert screen coordinates to Tile coordinates
 void ScreenToTile(int pX, int pY, int x0, int y0, int tileSize, int *tX, int *tY)
 {
@@ -309,16 +232,6 @@ void NormalChessPosToScreen(int row, int col, int x0, int y0, int tileSize, int
 	TileToScreen(col, row, x0, y0, tileSize, x, y);
 }
 
-NormalChessPiece *NormalChessPieceAlloc(NormalChessKind k, int row, int col)
-{
-	NormalChessPiece *new = malloc(sizeof(*new));
-	assert(new);
-	new->kind = k;
-	new->row = row;
-	new->col = col;
-	return new;
-}
-
 void SpriteSetAsNormalChessPiece(Sprite *s, NormalChessPiece *p)
 {
 	assert(s);
@@ -326,94 +239,6 @@ void SpriteSetAsNormalChessPiece(Sprite *s, NormalChessPiece *p)
 	s->data.as_normalChessPiece = p;
 }
 
-void NormalChessPieceFree(NormalChessPiece *p)
-{
-	free(p);
-}
-
-// arrPieces is a dynamic array
-NormalChess *NormalChessAlloc(int turn, NormalChessPiece **arrPieces)
-{
-	NormalChess *new = malloc(sizeof(*new));
-	assert(new);
-	new->turn = turn;
-	new->arrPieces = arrPieces;
-	new->doublePawnCol = -1;
-	new->hasWhiteKingMoved = 0;
-	new->hasWhiteKingsRookMoved = 0;
-	new->hasWhiteQueensRookMoved= 0;
-	new->hasBlackKingMoved = 0;
-	new->hasBlackKingsRookMoved = 0;
-	new->hasBlackQueensRookMoved = 0;
-	return new;
-}
-
-void NormalChessFree(NormalChess *p)
-{
-	free(p);
-}
-
-// Allocates new
-NormalChess *NormalChessInit(void)
-{
-	NormalChessPiece **pieces = NULL;
-	NormalChessPiece *p;
-	// Create the pawn ranks
-	for (int col = 0; col < 8; col++)
-	{
-		p = NormalChessPieceAlloc(WHITE_PAWN, 1, col);
-		arrput(pieces, p);
-		p = NormalChessPieceAlloc(BLACK_PAWN, 6, col);
-		arrput(pieces, p);
-	}
-	// White pieces
-	p = NormalChessPieceAlloc(WHITE_ROOK, 0, 0);
-	arrput(pieces, p);
-	p = NormalChessPieceAlloc(WHITE_KNIGHT, 0, 1);
-	arrput(pieces, p);
-	p = NormalChessPieceAlloc(WHITE_BISHOP, 0, 2);
-	arrput(pieces, p);
-	p = NormalChessPieceAlloc(WHITE_QUEEN, 0, 3);
-	arrput(pieces, p);
-	p = NormalChessPieceAlloc(WHITE_KING, 0, 4);
-	arrput(pieces, p);
-	p = NormalChessPieceAlloc(WHITE_BISHOP, 0, 5);
-	arrput(pieces, p);
-	p = NormalChessPieceAlloc(WHITE_KNIGHT, 0, 6);
-	arrput(pieces, p);
-	p = NormalChessPieceAlloc(WHITE_ROOK, 0, 7);
-	arrput(pieces, p);
-	// Black pieces
-	p = NormalChessPieceAlloc(BLACK_ROOK, 7, 0);
-	arrput(pieces, p);
-	p = NormalChessPieceAlloc(BLACK_KNIGHT, 7, 1);
-	arrput(pieces, p);
-	p = NormalChessPieceAlloc(BLACK_BISHOP, 7, 2);
-	arrput(pieces, p);
-	p = NormalChessPieceAlloc(BLACK_QUEEN, 7, 3);
-	arrput(pieces, p);
-	p = NormalChessPieceAlloc(BLACK_KING, 7, 4);
-	arrput(pieces, p);
-	p = NormalChessPieceAlloc(BLACK_BISHOP, 7, 5);
-	arrput(pieces, p);
-	p = NormalChessPieceAlloc(BLACK_KNIGHT, 7, 6);
-	arrput(pieces, p);
-	p = NormalChessPieceAlloc(BLACK_ROOK, 7, 7);
-	arrput(pieces, p);
-	return NormalChessAlloc(0, pieces);
-}
-
-void NormalChessDestroy(NormalChess *p)
-{
-	int len = arrlen(p->arrPieces);
-	for (int i = 0; i < len; i++)
-	{
-		NormalChessPieceFree(p->arrPieces[i]);
-	}
-	arrfree(p->arrPieces);
-	NormalChessFree(p);
-}
-
 // Rectangle slice of where a piece kind's texture is on
 // the spritesheet.
 Rectangle NormalChessKindToTextureRect(NormalChessKind k)
@@ -438,866 +263,32 @@ Rectangle NormalChessKindToTextureRect(NormalChessKind k)
 	return lookup[k];
 }
 
-// Removes any pieces with the given row and column.
-// FREEs the piece pointer too!
-void PiecesRemovePieceAt(NormalChessPiece **arrPieces, int row, int col)
-{
-	for (int i = 0; i < arrlen(arrPieces); i++)
-	{
-		NormalChessPiece *p = arrPieces[i];
-		if (p->row == row && p->col == col)
-		{
-			NormalChessPieceFree(p);
-			arrPieces[i] = NULL;
-			arrdelswap(arrPieces, i);
-		}
-	}
-}
-
-// Find the king piece for a kind.
-const NormalChessPiece *PiecesFindKing(const NormalChessPiece **arrPieces, NormalChessKind k)
-{
-	assert(arrPieces);
-	NormalChessKind king = NormalChessKingKind(k);
-	for (int i = 0; i < arrlen(arrPieces); i++)
-	{
-		const NormalChessPiece *p = arrPieces[i];
-		assert(p);
-		if (p->kind == king)
-		{
-			return p;
-		}
-	}
-	return NULL;
-}
-
-// Get the first piece found in the array with the given location.
-// Returns NULL if no piece is found.
-NormalChessPiece *PiecesGetAt(NormalChessPiece **arrPieces, int row, int col)
-{
-	for (int i = 0; i < arrlen(arrPieces); i++)
-	{
-		NormalChessPiece *p = arrPieces[i];
-		if (p->row == row && p->col == col)
-		{
-			return p;
-		}
-	}
-	return NULL;
-}
-
-const NormalChessPiece *PiecesGetAtConst(const NormalChessPiece **arrPieces, int row, int col)
-{
-	for (int i = 0; i < arrlen(arrPieces); i++)
-	{
-		const NormalChessPiece *p = arrPieces[i];
-		if (p->row == row && p->col == col)
-		{
-			return p;
-		}
-	}
-	return NULL;
-}
-
-int PiecesCountAtConst(const NormalChessPiece **arrPieces, int row, int col)
-{
-	int count = 0;
-	for (int i = 0; i < arrlen(arrPieces); i++)
-	{
-		const NormalChessPiece *p = arrPieces[i];
-		if (p->row == row && p->col == col)
-		{
-			count++;
-		}
-	}
-	return count;
-}
-
-NormalChessPiece *NormalChessGetPawnPromotion(NormalChess *chess)
-{
-	assert(chess);
-	for (int i = 0; i < arrlen(chess->arrPieces); i++)
-	{
-		NormalChessPiece *p = chess->arrPieces[i];
-		if (NormalChessCanUsePiece(chess, p))
-		{
-			// White pawn must reach row 7.
-			// Black pawn must reach row 0.
-			if ((p->kind == WHITE_PAWN && p->row == 7) || (p->kind == BLACK_PAWN && p->row == 0))
-			{
-				return p;
-			}
-		}
-	}
-	return NULL;
-}
-
-NormalChessPiece *NormalChessMoveGetSubject(NormalChessMove move, NormalChessPiece **arrPieces)
-{
-	if (move.subjectRow < 0 || move.subjectRow > 7 || move.subjectCol < 0 || move.subjectCol > 7)
-	{
-		return NULL;
-	}
-	return PiecesGetAt(arrPieces, move.subjectRow, move.subjectCol);
-}
-
-NormalChessPiece *NormalChessMoveGetObject(NormalChessMove move, NormalChessPiece **arrPieces)
-{
-	if (move.objectRow < 0 || move.objectRow > 7 || move.objectCol < 0 || move.objectCol > 7)
-	{
-		return NULL;
-	}
-	return PiecesGetAt(arrPieces, move.objectRow, move.objectCol);
-}
-
-// Move the piece at start to target
-// (there should not be a piece already at target).
-void PiecesDoMove(NormalChessPiece **arrPieces, int startRow, int startCol, int targetRow, int targetCol)
-{
-	// There should not be a piece at the target location.
-	assert(!PiecesGetAt(arrPieces, targetRow, targetCol));
-	// Find the piece in the array at the location and move it
-	NormalChessPiece *p = PiecesGetAt(arrPieces, startRow, startCol);
-	assert(p);
-	p->row = targetRow;
-	p->col = targetCol;
-}
-
-// Remove the piece at target and move the piece at start to the target.
-void PiecesDoCapture(NormalChessPiece **arrPieces, int startRow, int startCol,
-		int targetRow, int targetCol)
-{
-	assert(arrPieces);
-	PiecesRemovePieceAt(arrPieces, targetRow, targetCol);
-	PiecesDoMove(arrPieces, startRow, startCol, targetRow, targetCol);
-}
-
-// Returns if a piece could possibly move to the given location.
-int NormalChessMovesContains(const NormalChessPiece *p, int row, int col)
-{
-	int dRow = row - p->row;
-	int dCol = col - p->col;
-	// Pieces cannot move to their own square
-	if (dRow == 0 && dCol == 0)
-	{
-		return 0;
-	}
-	switch (p->kind)
-	{
-		case WHITE_KING:
-		case BLACK_KING:
-			// # # #
-			// # * #
-			// # # #
-			return (abs(dRow) <= 1) && (abs(dCol) <= 1);
-		case WHITE_QUEEN:
-		case BLACK_QUEEN:
-			// # . . # . . #
-			// . # . # . # .
-			// . . # # # . .
-			// # # # * # # #
-			// . . # # # . .
-			// . # . # . # .
-			// # . . # . . #
-			// Rook || Bishop
-			return (dRow == 0 || dCol == 0)
-				|| (abs(dRow) == abs(dCol));
-		case WHITE_ROOK:
-		case BLACK_ROOK:
-			// . . . # . . .
-			// . . . # . . .
-			// . . . # . . .
-			// # # # * # # #
-			// . . . # . . .
-			// . . . # . . .
-			// . . . # . . .
-			return dRow == 0 || dCol == 0;
-		case WHITE_BISHOP:
-		case BLACK_BISHOP:
-			// # . . . . . #
-			// . # . . . # .
-			// . . # . # . .
-			// . . . * . . .
-			// . . # . # . .
-			// . # . . . # .
-			// # . . . . . #
-			return abs(dRow) == abs(dCol);
-		case WHITE_KNIGHT:
-		case BLACK_KNIGHT:
-			// . . # . # . .
-			// . # . . . # .
-			// . . . * . . .
-			// . # . . . # .
-			// . . # . # . .
-			return (abs(dRow) == 2 && abs(dCol) == 1)
-				|| (abs(dRow) == 1 && abs(dCol) == 2);
-		case WHITE_PAWN:
-			// # # #
-			// . * .
-			// . . .
-			return dRow == 1 && abs(dCol) <= 1;
-		case BLACK_PAWN:
-			// . . .
-			// . * .
-			// # # #
-			return dRow == -1 && abs(dCol) <= 1;
-		default:
-			assert(0 && "invalid chess piece kind");
-	}
-}
-
-// Pawns and sliding pieces
-int PiecesMoveIsBlocked(const NormalChessPiece **arrPieces, const NormalChessPiece *p, int targetRow,
-		int targetCol)
-{
-	assert(arrPieces);
-	assert(p);
-	// If there is another piece on the same square as the given piece, then
-	// the piece is considered blocked. This is only the case for checking if
-	// a piece is pinned and we want to simulate a capture without affecting
-	// the other pieces.
-	if (PiecesCountAtConst(arrPieces, p->row, p->col) > 1)
-	{
-		return 1;
-	}
-	switch (p->kind)
-	{
-		case WHITE_PAWN:
-		case BLACK_PAWN:
-			{
-				// Pawn is blocked for diagonal moves if there is no piece for it to capture at the
-				// square. Pawn is also blocked for forward moves if there is a piece blocking,
-				// because it cannot capture forwards.
-				const NormalChessPiece *targetP = PiecesGetAtConst(arrPieces, targetRow, targetCol);
-				return (targetCol != p->col && !targetP) || (targetCol == p->col && targetP);
-			}
-		case WHITE_QUEEN:
-		case BLACK_QUEEN:
-		case WHITE_BISHOP:
-		case BLACK_BISHOP:
-		case WHITE_ROOK:
-		case BLACK_ROOK:
-			// Is a sliding piece, so trace the path from the piece to the target.
-			// And if any piece is found along the way, the square is blocked.
-			{
-				int dRow = sign(targetRow - p->row);
-				int dCol = sign(targetCol - p->col);
-				int row = p->row + dRow;
-				int col = p->col + dCol;
-				while (!(row == targetRow && col == targetCol)
-						&& row >= 0 && row <= 7
-						&& col >= 0 && col <= 7
-						&& !PiecesGetAtConst(arrPieces, row, col))
-				{
-					row += dRow;
-					col += dCol;
-				}
-				return row != targetRow || col != targetCol;
-			}
-		default:
-			// A non-sliding piece -> not blocked
-			return 0;
-	}
-}
-
-int PiecesCanTeamCaptureSpot(const NormalChessPiece **arrPieces, NormalChessKind team, int targetRow,
-		int targetCol)
-{
-	for (int i = 0; i < arrlen(arrPieces); i++)
-	{
-		const NormalChessPiece *member = arrPieces[i];
-		assert(member);
-		// Note: do not check special moves.
-		if (PieceKingOf(member) == NormalChessKingKind(team)
-				&& NormalChessMovesContains(member, targetRow, targetCol)
-				&& !PiecesMoveIsBlocked(arrPieces, member, targetRow, targetCol))
-		{
-			return 1;
-		}
-	}
-	return 0;
-}
-
-
-// Special moves in normal chess:
-//  - Pawns -> double first move and en passant
-//  - Kings -> castling
-int NormalChessSpecialMovesContains(const NormalChess *chess, const NormalChessPiece *p, int row, int col)
-{
-	if (!p)
-	{
-		return 0;
-	}
-	int dRow = row - p->row;
-	int dCol = col - p->col;
-	NormalChessKind enemyKing = NormalChessEnemyKingKind(p->kind);
-	const NormalChessPiece **arrPiecesConst = (const NormalChessPiece **) chess->arrPieces;
-	switch (p->kind)
-	{
-		case WHITE_PAWN:
-			// Double first move OR En passant
-			if (p->row == 1 && dRow == 2 && dCol == 0
-					&& !PiecesGetAtConst(arrPiecesConst, p->row + 1, p->col)
-					&& !PiecesGetAtConst(arrPiecesConst, p->row + 2, p->col))
-			{
-				// Double first move
-				return 1;
-			}
-			else if (p->row == 4 && dRow == 1 && chess->doublePawnCol == col)
-			{
-				// En passant
-				const NormalChessPiece *other = PiecesGetAtConst(arrPiecesConst, p->row, col);
-				return other && other->kind == BLACK_PAWN;
-			}
-			else
-			{
-				return 0;
-			}
-		case BLACK_PAWN:
-			// Double first move OR En passant
-			if (p->row == 6 && dRow == -2 && dCol == 0
-					&& !PiecesGetAtConst(arrPiecesConst, p->row - 1, p->col)
-					&& !PiecesGetAtConst(arrPiecesConst, p->row - 2, p->col))
-			{
-				// Double first move
-				return 1;
-			}
-			else if (p->row == 3 && dRow == -1 && chess->doublePawnCol == col)
-			{
-				// En passant
-				NormalChessPiece *other = PiecesGetAt(chess->arrPieces, p->row, col);
-				return other && other->kind == WHITE_PAWN;
-			}
-			else
-			{
-				return 0;
-			}
-		case WHITE_KING:
-			{
-				if (PiecesCanTeamCaptureSpot(arrPiecesConst, enemyKing, p->row, p->col))
-				{
-					// Cannot castle when in the king is in check.
-					return 0;
-				}
-				else if (dCol > 0)
-				{
-					// King's side castle
-					return !chess->hasWhiteKingMoved 
-						&& !chess->hasWhiteKingsRookMoved
-						&& dCol == 2
-						&& dRow == 0
-						&& PiecesGetAtConst(arrPiecesConst, p->row, 7) // must be rook piece
-						&& !PiecesGetAtConst(arrPiecesConst, p->row, p->col + 1)
-						&& !PiecesCanTeamCaptureSpot(arrPiecesConst, enemyKing, p->row, p->col + 1)
-						&& !PiecesCanTeamCaptureSpot(arrPiecesConst, enemyKing, p->row, p->col + 2);
-				}
-				else if (dCol < 0)
-				{
-					// Queen's side castle
-					return !chess->hasWhiteKingMoved 
-						&& !chess->hasWhiteQueensRookMoved
-						&& dCol == -2
-						&& dRow == 0
-						&& PiecesGetAtConst(arrPiecesConst, p->row, 0) // must be rook piece
-						&& !PiecesGetAt(chess->arrPieces, p->row, p->col - 1)
-						&& !PiecesCanTeamCaptureSpot(arrPiecesConst, enemyKing, p->row, p->col - 1)
-						&& !PiecesCanTeamCaptureSpot(arrPiecesConst, enemyKing, p->row, p->col - 2)
-						&& !PiecesCanTeamCaptureSpot(arrPiecesConst, enemyKing, p->row, p->col - 3);
-				}
-				else
-				{
-					return 0;
-				}
-				break;
-			}
-		case BLACK_KING:
-			if (PiecesCanTeamCaptureSpot(arrPiecesConst, enemyKing, p->row, p->col))
-			{
-				// Cannot castle when in the king is in check.
-				return 0;
-			}
-			if (dCol > 0)
-			{
-				// King's side castle
-				return !chess->hasBlackKingMoved 
-					&& !chess->hasBlackKingsRookMoved
-					&& dCol == 2
-					&& dRow == 0
-					&& PiecesGetAtConst(arrPiecesConst, p->row, 7) // must be rook piece
-					&& !PiecesGetAtConst(arrPiecesConst, p->row, p->col + 1)
-					&& !PiecesCanTeamCaptureSpot(arrPiecesConst, enemyKing, p->row, p->col + 1)
-					&& !PiecesCanTeamCaptureSpot(arrPiecesConst, enemyKing, p->row, p->col + 2);
-			}
-			else if (dCol < 0)
-			{
-				// Queen's side castle
-				return !chess->hasBlackKingMoved 
-					&& !chess->hasBlackQueensRookMoved
-					&& dCol == -2
-					&& dRow == 0
-					&& PiecesGetAtConst(arrPiecesConst, p->row, 0) // must be rook piece
-					&& !PiecesGetAtConst(arrPiecesConst, p->row, p->col - 1)
-					&& !PiecesCanTeamCaptureSpot(arrPiecesConst, enemyKing, p->row, p->col - 1)
-					&& !PiecesCanTeamCaptureSpot(arrPiecesConst, enemyKing, p->row, p->col - 2)
-					&& !PiecesCanTeamCaptureSpot(arrPiecesConst, enemyKing, p->row, p->col - 3);
-			}
-			else
-			{
-				return 0;
-			}
-		default:
-			return 0;
-	}
-}
-
-void TestNormalChessMovesContains(void)
-{
-	// int NormalChessMovesContains(NormalChessPiece p, int row, int col);
-	NormalChessPiece p1;
-
-	p1 = (NormalChessPiece){ .kind = WHITE_PAWN, .row = 0, .col = 4 };
-	assert(!NormalChessMovesContains(&p1, 0, 4));
-
-	p1 = (NormalChessPiece){ .kind = BLACK_PAWN, .row = 7, .col = 3 };
-	assert(!NormalChessMovesContains(&p1, 7, 3));
-}
-
-NormalChessMove NormalChessCreateCastleMove(NormalChess *chess, NormalChessPiece *p, int targetCol)
-{
-	// Cases: queen's side castle or king's side castle
-	assert(chess);
-	assert(p);
-	assert(targetCol == 6 || targetCol == 2);
-	int rookStartCol;
-	if (targetCol == 6)
-	{
-		// King's side
-		rookStartCol = 7;
-	}
-	else
-	{
-		// Queen's side
-		rookStartCol = 0;
-	}
-	NormalChessPiece *object = PiecesGetAt(chess->arrPieces, p->row, rookStartCol);
-	return (NormalChessMove)
-	{
-		.subjectCol = p->col,
-		.subjectRow = p->row,
-		.objectCol  = object->col,
-		.objectRow  = object->row,
-		.targetCol  = targetCol,
-		.targetRow  = p->row,
-	};
-}
-
-// Returns: row of captured piece, if any, and returns negative otherwise.
-NormalChessMove NormalChessCreatePawnMove(NormalChess *chess, NormalChessPiece *p, int targetCol,
-		int targetRow)
-{
-	// Cases: capture move, en passant move, or first move is a double move.
-	int dRow = targetRow - p->row;
-	int dCol = targetCol - p->col;
-	if (abs(dRow) == 2)
-	{
-		// First move is double move. Cannot be a capture.
-		assert(!PiecesGetAt(chess->arrPieces, targetRow, targetCol));
-		return (NormalChessMove)
-		{
-			.subjectCol = p->col,
-			.subjectRow = p->row,
-			.objectCol  = -1,
-			.objectRow  = -1,
-			.targetCol  = targetCol,
-			.targetRow  = targetRow,
-		};
-	}
-	else
-	{
-		// En-passant capture or normal capture.
-		// It is en passant if the pawn is moving diagonal to capture and there is no
-		// piece to capture at that target square.
-		assert(dCol);
-		NormalChessPiece *target = PiecesGetAt(chess->arrPieces, targetRow, targetCol);
-		if (!target)
-		{
-			// En passant capture -> remove the other pawn which is next to this one
-			target = PiecesGetAt(chess->arrPieces, p->row, targetCol);
-		}
-		assert(target);
-		assert(p);
-		return (NormalChessMove)
-		{
-			.subjectCol = p->col,
-			.subjectRow = p->row,
-			.objectCol  = target->col,
-			.objectRow  = p->row,
-			.targetCol  = targetCol,
-			.targetRow  = targetRow,
-		};
-	}
-}
-
-// Handle normal moves and special moves like castling.
-NormalChessMove NormalChessCreateMove(NormalChess *chess, int startCol, int startRow, int targetCol, 
-		int targetRow)
-{
-	assert(chess);
-	assert(chess->arrPieces);
-	NormalChessPiece *p = PiecesGetAt(chess->arrPieces, startRow, startCol);
-	assert(p);
-	if (NormalChessSpecialMovesContains(chess, p, targetRow, targetCol))
-	{
-		// Special move.
-		switch (p->kind)
-		{
-			case WHITE_KING:
-			case BLACK_KING:
-				// King's special move is castling.
-				return NormalChessCreateCastleMove(chess, p, targetCol);
-			case WHITE_PAWN:
-			case BLACK_PAWN:
-				// Pawn's speical move is a double move or en passant.
-				return NormalChessCreatePawnMove(chess, p, targetCol, targetRow);
-			default:
-				assert(0 && "did not handle all special moves");
-		}
-	}
-	else
-	{
-		// Normal move.
-		assert(p);
-		NormalChessPiece *obj = PiecesGetAt(chess->arrPieces, targetRow, targetCol);
-		return (NormalChessMove)
-		{
-			.subjectCol = p->col,
-			.subjectRow = p->row,
-			.objectCol  = obj? obj->col : -1,
-			.objectRow  = obj? obj->row : -1,
-			.targetCol  = targetCol,
-			.targetRow  = targetRow,
-		};
-	}
-}
-
-// Do castle move.
-void NormalChessDoCastle(NormalChess *chess, NormalChessMove move)
-{
-	NormalChessPiece *king = NormalChessMoveGetSubject(move, chess->arrPieces);
-	assert(king);
-	assert(NormalChessSpecialMovesContains(chess, king, move.targetRow, move.targetCol));
-	NormalChessPiece *rook = NormalChessMoveGetObject(move, chess->arrPieces);
-	assert(rook);
-	// Move the castle (because the king is moved normally in another function).
-	int rookTargetCol;
-	if (move.objectCol > move.subjectCol)
-	{
-		// King's-side rook
-		rookTargetCol = move.targetCol - 1;
-		// Update this additional movement flag for this rook.
-		switch (king->kind)
-		{
-			case WHITE_KING:
-				chess->hasWhiteKingsRookMoved = 1;
-				break;
-			case BLACK_KING:
-				chess->hasBlackKingsRookMoved = 1;
-				break;
-			default:
-				assert(0 && "unreachable");
-		}
-	}
-	else
-	{
-		// Queen's-side rook
-		rookTargetCol = move.targetCol + 1;
-		// Update this additional movement flag for this rook.
-		switch (king->kind)
-		{
-			case WHITE_KING:
-				chess->hasWhiteQueensRookMoved = 1;
-				break;
-			case BLACK_KING:
-				chess->hasBlackQueensRookMoved = 1;
-				break;
-			default:
-				assert(0 && "unreachable");
-		}
-	}
-	PiecesDoMove(chess->arrPieces, move.objectRow, move.objectCol, move.objectRow, rookTargetCol);
-}
-
-void NormalChessDoPawnSpecial(NormalChess *chess, NormalChessMove move)
-{
-	NormalChessPiece *p = NormalChessMoveGetSubject(move, chess->arrPieces);
-	assert(p);
-	assert(NormalChessSpecialMovesContains(chess, p, move.targetRow, move.targetCol));
-	if (move.targetCol != move.subjectCol)
-	{
-		// En Passant -> capture the adjacent pawn.
-		PiecesRemovePieceAt(chess->arrPieces, move.subjectRow, move.targetCol);
-	}
-	else
-	{
-		// Double pawn move -> update the last double pawn column
-		chess->doublePawnCol = move.subjectCol;
-	}
-}
-
-// Update any flags that result from moving the king or rooks (for castling).
-void NormalChessUpdateMovementFlags(NormalChess *chess, NormalChessMove move)
-{
-	NormalChessPiece *moveSubject = NormalChessMoveGetSubject(move, chess->arrPieces);
-	assert(moveSubject);
-	// If the subject moves.
-	switch (moveSubject->kind)
-	{
-		case WHITE_KING:
-			// King moved.
-			chess->hasWhiteKingMoved = 1;
-			break;
-		case BLACK_KING:
-			// King moved.
-			chess->hasBlackKingMoved = 1;
-			break;
-		case WHITE_ROOK:
-			// Rook moved.
-			if (move.targetCol > move.subjectCol)
-			{
-				// King's side
-				chess->hasWhiteKingsRookMoved = 1;
-			}
-			else
-			{
-				// Queen's side
-				chess->hasWhiteQueensRookMoved = 1;
-			}
-			break;
-		case BLACK_ROOK:
-			// Rook moved.
-			if (move.targetCol > move.subjectCol)
-			{
-				// King's side
-				chess->hasBlackKingsRookMoved = 1;
-			}
-			else
-			{
-				// Queen's side
-				chess->hasBlackQueensRookMoved = 1;
-			}
-			break;
-		default:
-			// No flags to update for other pieces.
-			break;
-	}
-	// If a rook is captured, it is considered to have moved so that castling
-	// is no longer possible with that rook.
-	NormalChessPiece *moveObject = NormalChessMoveGetObject(move, chess->arrPieces);
-	if (moveObject)
-	{
-		switch (moveObject->kind)
-		{
-			case WHITE_ROOK:
-				// Rook was captured.
-				if (move.objectCol > 4)
-				{
-					// King's side
-					chess->hasWhiteKingsRookMoved = 1;
-				}
-				else
-				{
-					// Queen's side
-					chess->hasWhiteQueensRookMoved = 1;
-				}
-				break;
-			case BLACK_ROOK:
-				// Rook was captured.
-				if (move.objectCol > 4)
-				{
-					// King's side
-					chess->hasBlackKingsRookMoved = 1;
-				}
-				else
-				{
-					// Queen's side
-					chess->hasBlackQueensRookMoved = 1;
-				}
-				break;
-			default:
-				// No flags to update for other pieces.
-				break;
-		}
-	}
-}
-
-void NormalChessDoMove(NormalChess *chess, NormalChessMove move)
-{
-	assert(chess);
-	assert(move.subjectCol >= 0 && move.subjectCol <= 7);
-	assert(move.subjectRow >= 0 && move.subjectRow <= 7);
-	NormalChessPiece *moveSubject = NormalChessMoveGetSubject(move, chess->arrPieces);
-	assert(moveSubject);
-	if (NormalChessSpecialMovesContains(chess, moveSubject, move.targetRow, move.targetCol))
-	{
-		// Special move.
-		switch (moveSubject->kind)
-		{
-			case WHITE_KING:
-			case BLACK_KING:
-				// King's castling -> move the rook too.
-				NormalChessDoCastle(chess, move);
-				break;
-			case WHITE_PAWN:
-			case BLACK_PAWN:
-				// En passant requires capturing the other pawn that was next to the subject.
-				// Pawn's special move is a double move or en passant.
-				NormalChessDoPawnSpecial(chess, move);
-				break;
-			default:
-				assert(0 && "did not handle all special moves");
-		}
-	}
-	NormalChessUpdateMovementFlags(chess, move);
-	// The subject always moves/captures to the target spot.
-	PiecesDoCapture(chess->arrPieces, moveSubject->row, moveSubject->col, move.targetRow, move.targetCol);
-	// Do not increment to next turn yet
-}
-
-// See if a piece is prevented from moving to a target square because it is pinned.
-// currently causing a bug where capturing is not allowed even if the capture
-// un-pins the piece.
-int PiecesIsPiecePinned(const NormalChessPiece **arrPieces, NormalChessPiece *p, int targetRow,
-		int targetCol)
-{
-	assert(p);
-	const NormalChessPiece *king = PiecesFindKing(arrPieces, p->kind);
-	if (!king)
-	{
-		// No king means that the pieces cannot move.
-		return 1;
-	}
-	int originalRow = p->row;
-	int originalCol = p->col;
-	// Temporarily move the piece to where it want to go to see "what if".
-	p->row = targetRow;
-	p->col = targetCol;
-	// Check if any of the enemy pieces may capture the king.
-	// If this current piece moves to a square where one of the enemy pieces is, the enemy
-	// piece is considered to be blocked (the move is acting like a capture). 
-	int isPinned = PiecesCanTeamCaptureSpot(arrPieces, NormalChessEnemyKingKind(PieceKingOf(p)),
-			king->row, king->col);
-	// Restore the pieces original position.
-	p->row = originalRow;
-	p->col = originalCol;
-	return isPinned;
-}
-
-int NormalChessAllMovesContains(const NormalChess *c, NormalChessPiece *p, int row, int col)
-{
-	// Must be a square within the piece's normal moves or special moves.
-	int normal = NormalChessMovesContains(p, row, col);
-	int special = NormalChessSpecialMovesContains(c, p, row, col);
-	const NormalChessPiece **arrPiecesConst = (const NormalChessPiece**) c->arrPieces;
-	if (!normal && !special)
-	{
-		return 0;
-	}
-	// A piece cannot capture any pieces on the same team.
-	const NormalChessPiece *other = PiecesGetAtConst(arrPiecesConst, row, col);
-	if (other && NormalChessPieceTeamEq(p, other))
-	{
-		return 0;
-	}
-	// A sliding piece's moves are blocked by the first piece hit.
-	// TODO: comment why is the !special is here again?
-	if (!special && PiecesMoveIsBlocked(arrPiecesConst, p, row, col))
-	{
-		return 0;
-	}
-	// A piece may not move if it is pinned to the king
-	if (PiecesIsPiecePinned(arrPiecesConst, p, row, col))
-	{
-		return 0;
-	}
-	return 1;
-}
-
 // Get a list of all valid moves for a piece.
 // Returns: a NEW dynamic array of (col, row) which must be FREEd later.
-// NOTE: if creating these dynamic lists of move squares is too slow, etc, then
-// we can just keep a one-time-allocated array of booleans for whether each
-// square on the board can be moved to.
 Vector2 *NormalChessCreatePieceMoveList(const NormalChess *c, NormalChessPiece *p)
 {
 	Vector2 *result = NULL;
-	for (int row = 0; row < 8; row++)
+	if (!NormalChessCanUsePiece(c, p))
 	{
-		for (int col = 0; col < 8; col++)
-		{
-			if (NormalChessAllMovesContains(c, p, row, col))
-			{
-				Vector2 colRow = (Vector2){ col, row };
-				arrput(result, colRow);
-			}
-		}
-	}
-	return result;
-}
-
-int NormalChessIsKingInCheck(NormalChess *chess)
-{
-	NormalChessKind currentKing = NormalChessCurrentKing(chess);
-	const NormalChessPiece **arrPiecesConst = (const NormalChessPiece **) chess->arrPieces;
-	const NormalChessPiece *king = PiecesFindKing(arrPiecesConst, currentKing);
-	if (!king)
-	{
-		return 0;
+		return NULL;
 	}
-	return PiecesCanTeamCaptureSpot(arrPiecesConst, NormalChessEnemyKingKind(currentKing), king->row,
-			king->col);
-}
-
-int NormalChessCanMove(NormalChess *chess)
-{
-	assert(chess);
-	NormalChessKind king = NormalChessCurrentKing(chess);
-	// Check if any pieces on the curren team can move.
-	for (int i = 0; i < arrlen(chess->arrPieces); i++)
+	NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+	int count = NormalChessGenerateLegalMoves(c, moves);
+	for (int i = 0; i < count; i++)
 	{
-		NormalChessPiece *p = chess->arrPieces[i];
-		assert(p);
-		if (PieceKingOf(p) == king)
+		NormalChessMove m = moves[i];
+		if (NormalChessMoveSubject(m) == p->row * 8 + p->col)
 		{
-			Vector2 *moves = NormalChessCreatePieceMoveList(chess, p);
-			if (moves != NULL)
+			// Promotion moves have the same target square, so only add it once.
+			int target = NormalChessMoveTarget(m);
+			Vector2 colRow = (Vector2){ target % 8, target / 8 };
+			if (!Vector2ArrFind(result, colRow))
 			{
-				arrfree(moves);
-				return 1;
-			}
-			else
-			{
-				arrfree(moves);
+				arrput(result, colRow);
 			}
 		}
 	}
-	return 0;
-}
-
-int NormalChessIsStalemate(NormalChess *chess)
-{
-	return !NormalChessIsKingInCheck(chess) && !NormalChessCanMove(chess);
-}
-
-int NormalChessIsCheckmate(NormalChess *chess)
-{
-	return NormalChessIsKingInCheck(chess) && !NormalChessCanMove(chess);
-}
-
-int NormalChessIsGameOver(NormalChess *chess)
-{
-	return !NormalChessCanMove(chess)
-		|| !PiecesFindKing((const NormalChessPiece **)chess->arrPieces, WHITE_KING)
-		|| !PiecesFindKing((const NormalChessPiece **)chess->arrPieces, BLACK_KING);
+	return result;
 }
 
 void SpriteMoveToNormalChessPiece(Sprite *s, const GameContext *game)
@@ -1319,11 +310,14 @@ Sprite *SpritesArrCreateNormalChess(GameContext *game)
 	int x0 = game->boardOffset.x;
 	int y0 = game->boardOffset.y;
 	int tileSize = game->tileSize;
-	NormalChessPiece **arrPieces = game->normalChess->arrPieces;
-	for (int i = 0; i < arrlen(arrPieces); i++)
+	NormalChess *chess = game->normalChess;
+	for (int i = 0; i < chess->pieceCount; i++)
 	{
-		NormalChessPiece *piece = arrPieces[i];
-		assert(piece);
+		NormalChessPiece *piece = &chess->pieces[i];
+		if (!PiecesIsOnBoard(chess, piece))
+		{
+			continue;
+		}
 		Sprite new;
 		new.data = (SpriteData){ .kind = SK_NORMAL_CHESS_PIECE, .as_normalChessPiece = piece };
 		new.boundingBox = (Rectangle){ 0, 0, 16, 16};
@@ -1346,6 +340,9 @@ void GameCleanupState(GameContext *game)
 		case GS_PLAY_ANIMATE:
 		case GS_PLAY_PROMOTE:
 		case GS_GAME_OVER:
+			// Stop the computer from thinking (or pondering or analyzing) about a game that is gone
+			GameStopComputer(game);
+			game->isAnalyzing = 0;
 			// Free normal chess game
 			assert(game->normalChess != NULL);
 			NormalChessDestroy(game->normalChess);
@@ -1493,10 +490,14 @@ void GameEnterStatePlayPromote(GameContext *game, GameState previous)
 	const int gapY = 5; // px
 	const int numOptions = 4; // number of promotion pieces to choose from
 	const int teamOffsetY = 40; // px
+	// Use refSelectedSprite to refer to the pawn to promote.
+	NormalChessPiece *promoteP = NormalChessGetPawnPromotion(game->normalChess);
+	assert(promoteP);
+	game->refSelectedSprite = SpritesArrFindNormalChessSpriteFor(game->arrSprites, promoteP);
 	// Initialize promotion menu.
 	// Note that the menu's Y position moves down for when the black team is promoting because
 	// the piece is further down on the screen than for the white team.
-	NormalChessKind currentKing = NormalChessCurrentKing(game->normalChess);
+	NormalChessKind currentKing = PieceKingOf(promoteP);
 	game->promotionMenuRect = (Rectangle)
 	{
 		game->boardOffset.x + game->tileSize * 8 + 10,
@@ -1531,9 +532,6 @@ void GameEnterStatePlayPromote(GameContext *game, GameState previous)
 		};
 		arrput(game->arrUISprites, button);
 	}
-	// Use refSelectedSprite to refer to the pawn to promote.
-	NormalChessPiece *promoteP = NormalChessGetPawnPromotion(game->normalChess);
-	game->refSelectedSprite = SpritesArrFindNormalChessSpriteFor(game->arrSprites, promoteP);
 }
 
 void PlayInitBackgroundTiles(GameContext *game)
@@ -1696,15 +694,14 @@ void GameEnterStatePlay(GameContext *game, GameState previous)
 	if (previous == GS_PLAY_PROMOTE || previous == GS_PLAY_ANIMATE)
 	{
 		// Returning from in-game promotion or animation.
-		// TODO: check for game over
 		// TODO: play sounds here
 		// PlaySound(game->soundPromote);
 
-		// This is where the turn is incremented
-		game->normalChess->turn++;
+		// The turn has already been incremented by the chess move.
 		if (NormalChessIsGameOver(game->normalChess))
 		{
-			// If the game is over, switch states.
+			// If the game is over, switch states (and there is nothing to ponder).
+			GameStopComputer(game);
 			GameSwitchState(game, GS_GAME_OVER);
 			return;
 		}
@@ -1714,6 +711,15 @@ void GameEnterStatePlay(GameContext *game, GameState previous)
 		// Initialize the play state.
 		game->boardOffset = (Vector2) { 160, 110 };
 		game->normalChess = NormalChessInit();
+		if (game->engine)
+		{
+			EngineWorkerClearHash(game->engine);
+		}
+		else
+		{
+			EngineHashClear();
+		}
+		game->clocks[0] = game->clocks[1] = game->clockStartSeconds;
 		game->arrDraggedPieceMoves = NULL;
 		game->refSelectedSprite = NULL;
 		game->arrSprites = NULL;
@@ -1739,6 +745,10 @@ void GameEnterStatePlay(GameContext *game, GameState previous)
 		};
 		menuButton.data.as_genericButton.refText = "Quit";
 		arrput(game->arrUISprites, menuButton);
+		Sprite analyzeButton = menuButton;
+		analyzeButton.boundingBox = (Rectangle){ 10, 55, 100, 35 };
+		analyzeButton.data.as_genericButton.refText = "Analyze";
+		arrput(game->arrUISprites, analyzeButton);
 	}
 }
 
@@ -1753,7 +763,7 @@ void GameEnterStatePlayAnimate(GameContext *game, GameState previous)
 void GameEnterStateGameOver(GameContext *game, GameState previous)
 {
 	assert(previous == GS_PLAY);
-	assert(0 && "not implemented yet");
+	// Nothing to do: the board is still drawn under the game over message.
 }
 
 // Meant to be called by GameEnterState.
@@ -1828,7 +838,7 @@ NormalChessPiece *GameGetPieceAt(const GameContext *game, Vector2 screenPos)
 	}
 	int row, col;
 	ScreenToNormalChessPos(screenPos.x, screenPos.y, x0, y0, tileSize, &row, &col);
-	return PiecesGetAt(game->normalChess->arrPieces, row, col);
+	return PiecesGetAt(game->normalChess, row, col);
 }
 
 // TODO: do we need to use this?
@@ -1865,44 +875,15 @@ void UpdateMoveSquares(GameContext *game)
 }
 
 // Does: get info about whether a chess move is a capture and what the object (acted-upon piece) is.
-// Returns values through object and isCapture.
+// Returns: the subject piece, and values through object, isCapture, and isCastle.
 NormalChessPiece *NormalChessMoveGetObjectInfo(NormalChess *chess, NormalChessMove move, 
 		NormalChessPiece **object, int *isCapture, int *isCastle)
 {
-	NormalChessPiece *moveSubject = NormalChessMoveGetSubject(move, chess->arrPieces);
-	NormalChessPiece *moveObject = NormalChessMoveGetObject(move, chess->arrPieces);
-	if (NormalChessSpecialMovesContains(chess, moveSubject, move.targetRow, move.targetCol))
-	{
-		// This move is special, so see what kind it is.
-		assert(moveSubject);
-		switch (moveSubject->kind)
-		{
-			case WHITE_KING:
-			case BLACK_KING:
-				// King castling
-				if (isCapture) { *isCapture = 0; }
-				if (isCastle)  { *isCastle = 1; }
-				if (object)    { *object = moveObject; }
-				break;
-			case WHITE_PAWN:
-			case BLACK_PAWN:
-				// En passant or double move
-				if (isCapture) { *isCapture = move.targetCol != move.subjectCol; }
-				if (isCastle)  { *isCastle = 0; }
-				if (object)    { *object = moveObject; }
-				break;
-			default:
-				assert(0 && "did not handle a special move case");
-				break;
-		}
-	}
-	else
-	{
-		// Normal move case:
-		if (object)    { *object = moveObject; }
-		if (isCastle)  { *isCastle = 0; }
-		if (isCapture) { *isCapture = (moveObject != NULL); }
-	}
+	// The move flags say what kind of move it is.
+	if (object)    { *object = NormalChessMoveGetObject(move, chess); }
+	if (isCastle)  { *isCastle = NormalChessMoveIsCastle(move); }
+	if (isCapture) { *isCapture = NormalChessMoveIsCapture(move); }
+	return NormalChessMoveGetSubject(move, chess);
 }
 
 // Move the selected piece to the target. Also resets the handledCheck flag to 0.
@@ -1919,10 +900,17 @@ void GameDoMoveNormalChess(GameContext *game, int targetCol, int targetRow)
 	// Create the chess move that the user indicated.
 	NormalChessMove theMove = NormalChessCreateMove(game->normalChess, p->col, p->row, targetCol,
 			targetRow);
+	assert(theMove != NORMAL_CHESS_NO_MOVE);
 	// Create move info for handling the sprites after doing the chess move.
 	NormalChessPiece *object;
 	int isCapture, isCastle;
 	NormalChessMoveGetObjectInfo(game->normalChess, theMove, &object, &isCapture, &isCastle);
+	// The team that moved gets the clock increment (but the clocks are stopped for analysis).
+	if (game->clockStartSeconds > 0 && !game->isAnalyzing)
+	{
+		game->clocks[NormalChessTeamIndex(NormalChessCurrentKing(game->normalChess))] +=
+				game->clockIncrement;
+	}
 	// Do chess game move and sprite move.
 	NormalChessDoMove(game->normalChess, theMove);
 	SpriteMoveToNormalChessPiece(game->refSelectedSprite, game);
@@ -1947,6 +935,63 @@ void GameDoMoveNormalChess(GameContext *game, int targetCol, int targetRow)
 	UpdateMoveSquares(game);
 }
 
+// Get the limits for the computer's search: the time left on its clock if there are clocks (so that
+// the time manager decides how long to think for), or else a set time for each move.
+NormalChessSearchLimits GameComputerSearchLimits(const GameContext *game)
+{
+	assert(game);
+	if (game->clockStartSeconds <= 0)
+	{
+		return (NormalChessSearchLimits){ .seconds = game->computerSeconds };
+	}
+	return (NormalChessSearchLimits)
+	{
+		.clockSeconds = game->clocks[NormalChessTeamIndex(game->computerTeam)],
+		.incrementSeconds = game->clockIncrement,
+	};
+}
+
+// Stop whatever the computer is thinking about (its move, pondering or analysis).
+void GameStopComputer(GameContext *game)
+{
+	assert(game);
+	if (game->engine)
+	{
+		EngineWorkerStop(game->engine);
+	}
+	EngineSliceFree(game->slicedSearch);
+	game->slicedSearch = NULL;
+	game->computerSearchId = 0;
+	game->analysisId = 0;
+}
+
+// Do the move that the computer chose for the current team.
+void GameDoComputerMoveNormalChess(GameContext *game, NormalChessMove move)
+{
+	assert(game);
+	assert(game->normalChess);
+	// The game would be over if there was no move.
+	assert(move != NORMAL_CHESS_NO_MOVE);
+	int subject = NormalChessMoveSubject(move);
+	int target = NormalChessMoveTarget(move);
+	int promoteKind = NormalChessMovePromoteKind(move,
+			NormalChessCurrentKing(game->normalChess));
+	// Do the move the same way as if the player had dragged the piece.
+	game->refSelectedSprite = SpritesArrFindNormalChessSpriteAt(game->arrSprites, subject % 8,
+			subject / 8);
+	GameDoMoveNormalChess(game, target % 8, target / 8);
+	if (promoteKind >= 0)
+	{
+		// The computer chooses what to promote to, instead of using the promotion menu.
+		NormalChessPiece *p = PiecesGetAt(game->normalChess, target / 8, target % 8);
+		NormalChessPromotePiece(game->normalChess, p, promoteKind);
+		NormalChessUpdateAttacks(game->normalChess);
+		Sprite *s = SpritesArrFindNormalChessSpriteFor(game->arrSprites, p);
+		assert(s);
+		s->textureRect = NormalChessKindToTextureRect(p->kind);
+	}
+}
+
 // Return if the button is activated.
 int SpriteButtonStateUpdate(ButtonState *bstate, Rectangle boundingBox)
 {
@@ -2036,11 +1081,56 @@ int UpdatePlayButtons(GameContext *game)
 				GameSwitchState(game, GS_MAIN_MENU);
 				return 1;
 			}
+			// Turn analysis mode on or off, which stops whatever the computer was thinking about.
+			// The button then offers the other mode and can be clicked again.
+			if (TextIsEqual(s->data.as_genericButton.refText, "Analyze")
+					|| TextIsEqual(s->data.as_genericButton.refText, "Play"))
+			{
+				game->isAnalyzing = !game->isAnalyzing;
+				GameStopComputer(game);
+				s->data.as_genericButton.refText = game->isAnalyzing? "Play" : "Analyze";
+				s->data.as_genericButton.state = BS_ENABLED;
+				return 1;
+			}
 		}
 	}
 	return 0;
 }
 
+// Keep the analysis going for the position on the board, and take the latest lines from it.
+void UpdatePlayAnalysis(GameContext *game)
+{
+	assert(game);
+	assert(game->isAnalyzing);
+	int isStarted = game->engine? game->analysisId != 0 : game->slicedSearch != NULL;
+	if (!isStarted || game->analysisKey != game->normalChess->key)
+	{
+		// Start analyzing (again, if there was a move).
+		game->analysis.lineCount = 0;
+		game->analysisKey = game->normalChess->key;
+		if (game->engine)
+		{
+			game->analysisId = EngineWorkerAnalyze(game->engine, game->normalChess,
+					GAME_ANALYSIS_LINES);
+		}
+		else
+		{
+			EngineSliceFree(game->slicedSearch);
+			game->slicedSearch = EngineSliceStart(game->normalChess,
+					(NormalChessSearchLimits){ .lines = GAME_ANALYSIS_LINES });
+		}
+	}
+	if (game->engine)
+	{
+		EngineWorkerPoll(game->engine, game->analysisId, &game->analysis);
+	}
+	else
+	{
+		EngineSliceRun(game->slicedSearch, 0, GAME_SEARCH_SLICE_SECONDS);
+		game->analysis = EngineSliceResult(game->slicedSearch);
+	}
+}
+
 // Note: when the chess move is valid and the game must update, then these game state transitions
 // occur:
 // * If the move is not a pawn promotion: GS_PLAY -> GS_ANIMATE -> GS_PLAY
@@ -2054,6 +1144,72 @@ void UpdatePlay(GameContext *game)
 	{
 		return;
 	}
+	if (game->isAnalyzing)
+	{
+		// In analysis mode, the clocks are stopped and the player moves for both teams.
+		UpdatePlayAnalysis(game);
+	}
+	else if (game->clockStartSeconds > 0)
+	{
+		// Run the clock of the team to move, and it loses when the time runs out.
+		int team = NormalChessTeamIndex(NormalChessCurrentKing(game->normalChess));
+		game->clocks[team] -= GetFrameTime();
+		if (game->clocks[team] <= 0)
+		{
+			game->clocks[team] = 0;
+			GameStopComputer(game);
+			GameSwitchState(game, GS_GAME_OVER);
+			return;
+		}
+	}
+	if (game->isComputerPlaying && !game->isAnalyzing
+			&& NormalChessCurrentKing(game->normalChess) == game->computerTeam)
+	{
+		// The computer's turn. The search runs on the engine thread, so that the game keeps
+		// drawing frames while the computer thinks, and the result is checked for every frame.
+		// Without an engine thread, a slice of the search runs in each frame instead.
+		NormalChessSearchResult result;
+		int isDone = 0;
+		if (game->engine)
+		{
+			if (!game->computerSearchId)
+			{
+				game->computerSearchId = EngineWorkerSearch(game->engine, game->normalChess,
+						GameComputerSearchLimits(game));
+			}
+			isDone = (game->computerSearchId
+					&& EngineWorkerPoll(game->engine, game->computerSearchId, &result) == EP_DONE);
+		}
+		else
+		{
+			if (!game->slicedSearch)
+			{
+				game->slicedSearch = EngineSliceStart(game->normalChess,
+						GameComputerSearchLimits(game));
+			}
+			isDone = EngineSliceRun(game->slicedSearch, 0, GAME_SEARCH_SLICE_SECONDS);
+			if (isDone)
+			{
+				result = EngineSliceResult(game->slicedSearch);
+				EngineSliceFree(game->slicedSearch);
+				game->slicedSearch = NULL;
+			}
+		}
+		if (isDone)
+		{
+			game->computerSearchId = 0;
+			GameDoComputerMoveNormalChess(game, result.move);
+			if (game->engine && result.ponder != NORMAL_CHESS_NO_MOVE)
+			{
+				// Keep thinking during the player's turn, assuming that they play the expected
+				// reply (and if they do, the computer's next search has a head start).
+				EngineWorkerPonder(game->engine, game->normalChess, result.ponder,
+						GameComputerSearchLimits(game));
+			}
+			GameSwitchState(game, GS_PLAY_ANIMATE);
+		}
+		return;
+	}
 	if (IsMouseButtonPressed(0))
 	{
 		// Handle mouse first pressed.
@@ -2094,7 +1250,7 @@ void UpdatePlay(GameContext *game)
 				if (Vector2ArrFind(game->arrDraggedPieceMoves, mouseSquare))
 				{
 					// Released mouse over a valid movement square for the piece.
-					// Do the chess game move. Do not increment game turn yet.
+					// Do the chess game move (which also goes to the next turn).
 					GameDoMoveNormalChess(game, col, row);
 					assert(!game->refSelectedSprite);
 					assert(!game->arrDraggedPieceMoves);
@@ -2159,7 +1315,8 @@ void UpdatePlayPromote(GameContext *game)
 			// Promote the pawn with the selection.
 			assert(game->refSelectedSprite);
 			NormalChessPiece *p = game->refSelectedSprite->data.as_normalChessPiece;
-			p->kind = s->data.as_promoteButton.pieceKind;
+			NormalChessPromotePiece(game->normalChess, p, s->data.as_promoteButton.pieceKind);
+			NormalChessUpdateAttacks(game->normalChess);
 			game->refSelectedSprite->textureRect = NormalChessKindToTextureRect(p->kind);
 			GameSwitchState(game, GS_PLAY_ANIMATE);
 		}
@@ -2198,7 +1355,7 @@ void UpdatePlayAnimate(GameContext *game)
 	// Check for pawn promotion.
 	if (NormalChessGetPawnPromotion(game->normalChess))
 	{
-		// Do promotion. Coming back from promotion state will increment chess game turn.
+		// Do promotion. The chess game turn was already incremented by the move.
 		GameSwitchState(game, GS_PLAY_PROMOTE);
 		return;
 	}
@@ -2416,6 +1573,16 @@ void DrawPlay(const GameContext *game)
 		assert(SpriteIsUI(s));
 		DrawSprite(game, s);
 	}
+	if (game->isAnalyzing)
+	{
+		DrawAnalysis(game);
+	}
+	// Draw the clocks, black's above the board and white's below it.
+	else if (game->clockStartSeconds > 0)
+	{
+		DrawClock(game, BLACK_KING, x0, y0 - 24);
+		DrawClock(game, WHITE_KING, x0, y0 + 8 * tileSize + 4);
+	}
 	// Draw the selected sprite piece now so it is always on top.
 	if (game->refSelectedSprite)
 	{
@@ -2423,10 +1590,127 @@ void DrawPlay(const GameContext *game)
 	}
 }
 
+// Draw an arrow with the head at the end point.
+void DrawArrow(Vector2 start, Vector2 end, float thick, Color color)
+{
+	float length = sqrtf(Vector2DistanceSquared(start, end));
+	if (length < 1)
+	{
+		return;
+	}
+	// Unit vector along the arrow, and the head's size.
+	float dx = (end.x - start.x) / length;
+	float dy = (end.y - start.y) / length;
+	float headLength = thick * 3;
+	float headWidth = thick * 2;
+	Vector2 base = (Vector2){ end.x - dx * headLength, end.y - dy * headLength };
+	DrawLineEx(start, base, thick, color);
+	Vector2 left = (Vector2){ base.x + dy * headWidth, base.y - dx * headWidth };
+	Vector2 right = (Vector2){ base.x - dy * headWidth, base.y + dx * headWidth };
+	// The triangle has to be counter-clockwise (on the screen) to be drawn.
+	float cross = (left.x - end.x) * (right.y - end.y) - (left.y - end.y) * (right.x - end.x);
+	if (cross < 0)
+	{
+		DrawTriangle(end, left, right, color);
+	}
+	else
+	{
+		DrawTriangle(end, right, left, color);
+	}
+}
+
+// Draw the analysis: an arrow for each of the best moves (the best one is the boldest), a bar
+// beside the board for how much better off white is, and the lines below the board.
+void DrawAnalysis(const GameContext *game)
+{
+	assert(game);
+	assert(game->normalChess);
+	const int x0 = game->boardOffset.x;
+	const int y0 = game->boardOffset.y;
+	const int tileSize = game->tileSize;
+	const NormalChessSearchResult *analysis = &game->analysis;
+	if (analysis->lineCount == 0 || game->analysisKey != game->normalChess->key)
+	{
+		DrawText("Analyzing...", x0, y0 + 8 * tileSize + 6, 10, RAYWHITE);
+		return;
+	}
+	// Arrows, with the best move drawn last so that it is on top.
+	for (int i = analysis->lineCount - 1; i >= 0; i--)
+	{
+		NormalChessMove move = analysis->lines[i].moves[0];
+		int subject = NormalChessMoveSubject(move);
+		int target = NormalChessMoveTarget(move);
+		int x1, y1, x2, y2;
+		NormalChessPosToScreen(subject / 8, subject % 8, x0, y0, tileSize, &x1, &y1);
+		NormalChessPosToScreen(target / 8, target % 8, x0, y0, tileSize, &x2, &y2);
+		Vector2 start = (Vector2){ x1 + tileSize/2, y1 + tileSize/2 };
+		Vector2 end = (Vector2){ x2 + tileSize/2, y2 + tileSize/2 };
+		Color color = (i == 0)? (Color){ 0, 121, 241, 200 } : (Color){ 0, 121, 241, 110 };
+		DrawArrow(start, end, (i == 0)? tileSize / 6.0f : tileSize / 10.0f, color);
+	}
+	// The scores are for the team to move, so flip them to be from white's point of view.
+	int sign = (NormalChessCurrentKing(game->normalChess) == WHITE_KING)? 1 : -1;
+	// Evaluation bar: white's part fills up from the bottom, and a 4 pawn lead fills most of it.
+	const int barHeight = 8 * tileSize;
+	float whiteShare = 1.0f / (1.0f + expf(-sign * analysis->lines[0].score / 200.0f));
+	int whiteHeight = (int)(whiteShare * barHeight);
+	DrawRectangle(x0 - 14, y0, 8, barHeight - whiteHeight, BLACK);
+	DrawRectangle(x0 - 14, y0 + barHeight - whiteHeight, 8, whiteHeight, RAYWHITE);
+	// The lines, with their scores in pawns (or "#" and the number of moves to checkmate).
+	for (int i = 0; i < analysis->lineCount; i++)
+	{
+		const NormalChessSearchLine *line = &analysis->lines[i];
+		char text[128];
+		int score = sign * line->score;
+		int matePlies = ENGINE_MATE_SCORE - abs(score);
+		int n;
+		if (matePlies <= ENGINE_MAX_PLY)
+		{
+			n = snprintf(text, sizeof(text), "#%c%d", (score > 0)? '+' : '-', (matePlies + 1) / 2);
+		}
+		else
+		{
+			n = snprintf(text, sizeof(text), "%+.2f", score / 100.0);
+		}
+		for (int j = 0; j < line->length && n + 6 < (int)sizeof(text); j++)
+		{
+			char moveStr[6];
+			NormalChessMoveToString(line->moves[j], moveStr);
+			n += snprintf(text + n, sizeof(text) - n, " %s", moveStr);
+		}
+		DrawText(text, x0, y0 + 8 * tileSize + 6 + 12 * i, 10, (i == 0)? RAYWHITE : LIGHTGRAY);
+	}
+	DrawText(TextFormat("depth %d", analysis->depth), x0,
+			y0 + 8 * tileSize + 6 + 12 * analysis->lineCount, 10, GRAY);
+}
+
+// Draw the time left on a team's clock, which is brighter while it is running.
+void DrawClock(const GameContext *game, NormalChessKind team, int x, int y)
+{
+	assert(game);
+	assert(game->normalChess);
+	double seconds = game->clocks[NormalChessTeamIndex(team)];
+	int isRunning = (game->state == GS_PLAY && NormalChessCurrentKing(game->normalChess) == team);
+	Color tint = isRunning? RAYWHITE : GRAY;
+	if (seconds < 10)
+	{
+		// Show tenths of a second when the time is nearly up.
+		DrawText(TextFormat("0:%04.1f", seconds), x, y, 20, tint);
+		return;
+	}
+	int wholeSeconds = (int)seconds;
+	DrawText(TextFormat("%d:%02d", wholeSeconds / 60, wholeSeconds % 60), x, y, 20, tint);
+}
+
 void DrawGameOver(const GameContext *game)
 {
 	DrawPlay(game);
 	DrawText("Game over", 20, 50, 16, RED);
+	if (game->clockStartSeconds > 0 && (game->clocks[0] <= 0 || game->clocks[1] <= 0))
+	{
+		DrawText((game->clocks[0] <= 0)? "White lost on time" : "Black lost on time", 20, 70, 16,
+				RED);
+	}
 }
 
 void DrawMainMenu(const GameContext *game)
@@ -2485,7 +1769,7 @@ void DrawPlayPromote(const GameContext *game)
 	int startX = game->refSelectedSprite->boundingBox.x + game->refSelectedSprite->boundingBox.width/2;
 	int startY = game->refSelectedSprite->boundingBox.y + game->refSelectedSprite->boundingBox.height/2;
 	int lineY1;
-	if (NormalChessCurrentKing(game->normalChess) == WHITE_KING)
+	if (PieceKingOf(game->refSelectedSprite->data.as_normalChessPiece) == WHITE_KING)
 	{
 		lineY1 = game->promotionMenuRect.y + arrowGap;
 	}
@@ -2570,6 +1854,11 @@ void GameResetState(GameContext *game)
 void GameCleanup(GameContext *game)
 {
 	GameCleanupState(game);
+	if (game->engine)
+	{
+		EngineWorkerQuit(game->engine);
+		game->engine = NULL;
+	}
 	// Make sure every pointer has been dealt with
 	assert(game->normalChess == NULL);
 	assert(game->arrDraggedPieceMoves == NULL);
@@ -2584,6 +1873,13 @@ void GameCleanup(GameContext *game)
 void Test(void)
 {
 	TestNormalChessMovesContains();
+	TestNormalChessBoard();
+	TestNormalChessGenerateMoves();
+	TestNormalChessMakeMove();
+	TestNormalChessCheckInfo();
+	TestNormalChessClone();
+	TestNormalChessFEN();
+	// The engine tests are slower, so they are in their own program (see enginetest.c).
 }
 
 /* vi: set colorcolumn=101 textwidth=100 tabstop=4 noexpandtab: */
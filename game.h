@@ -3,6 +3,8 @@
 
 #include "raylib.h"
 #include "tilemap.h"
+#include "normalchess.h"
+#include "engine.h"
 #include <assert.h>
 
 typedef enum GameState
@@ -17,22 +19,6 @@ typedef enum GameState
 #define _GS_COUNT (GS_MAIN_MENU + 1)
 _Static_assert(_GS_COUNT == 6, "exhaustive handling of all GameState's");
 
-typedef enum NormalChessKind
-{
-	WHITE_KING,
-	WHITE_QUEEN,
-	WHITE_ROOK,
-	WHITE_BISHOP,
-	WHITE_KNIGHT,
-	WHITE_PAWN,
-	BLACK_KING,
-	BLACK_QUEEN,
-	BLACK_ROOK,
-	BLACK_BISHOP,
-	BLACK_KNIGHT,
-	BLACK_PAWN,
-} NormalChessKind;
-
 typedef enum SpriteKind
 {
 	SK_NONE,
@@ -41,37 +27,6 @@ typedef enum SpriteKind
 	SK_NORMAL_CHESS_PIECE,
 } SpriteKind;
 
-typedef struct NormalChessPiece
-{
-	NormalChessKind kind;
-	int col; // position column
-	int row; // position row
-} NormalChessPiece;
-
-typedef struct NormalChessMove 
-{
-	int subjectCol; // The subject is the piece moving or capturing. The subject moves from this location.
-	int subjectRow;
-	int objectCol;  // The object is the other piece which is being captured (or is the rook when castling)
-	int objectRow;
-	int targetCol;  // The square the subject piece is moving to.
-	int targetRow;
-} NormalChessMove;
-
-// Normal-chess game data
-typedef struct NormalChess
-{
-	int turn;
-	int doublePawnCol; // column of the most recent double pawn move
-	int hasWhiteKingMoved;
-	int hasWhiteKingsRookMoved;
-	int hasWhiteQueensRookMoved;
-	int hasBlackKingMoved;
-	int hasBlackKingsRookMoved;
-	int hasBlackQueensRookMoved;
-	NormalChessPiece **arrPieces; // dynamic array
-} NormalChess;
-
 typedef enum ButtonState
 {
 	BS_DISABLED,  // unable to be used
@@ -116,6 +71,13 @@ typedef struct Sprite
 	const Texture2D *refTexture;
 } Sprite;
 
+// Number of best moves that analysis mode shows.
+#define GAME_ANALYSIS_LINES 3
+
+// Time for each frame to spend on a search when there is no engine thread (most of a frame at 30
+// frames per second).
+#define GAME_SEARCH_SLICE_SECONDS 0.02
+
 // Note: the .state member should not be modified directly to switch states
 // because there may be things to do to clean up the current state. Use the
 // function GameSwitchState(...) to switch states.
@@ -143,6 +105,20 @@ typedef struct GameContext
 	int stateTicks; // ticks since the current state was entered
 	int tileSize;
 	NormalChess *normalChess;
+	int isComputerPlaying;  // whether the computer plays one of the teams, or 0 for two players
+	NormalChessKind computerTeam;  // king kind of the team that the computer plays (if any)
+	double computerSeconds;  // time for the computer to think about each move (without clocks)
+	int computerThreads;  // threads that search for the computer at once (with an engine thread)
+	double clockStartSeconds;  // time on each team's clock at the start, or 0 for no clocks
+	double clockIncrement;  // seconds added to a team's clock after each of its moves
+	double clocks[2];  // time left on the clocks of white and black
+	int isAnalyzing;  // analysis mode: the computer shows the best lines instead of playing
+	int analysisId;  // id of the analysis search (see EngineWorkerAnalyze), or 0 if not started
+	uint64_t analysisKey;  // key of the position that is being analyzed
+	NormalChessSearchResult analysis;  // latest result of the analysis (lineCount is 0 if none)
+	EngineWorker *engine;  // thread that searches for the computer's moves, or NULL for none
+	EngineSlicedSearch *slicedSearch;  // without an engine thread: the search running, if any
+	int computerSearchId;  // id of the search for the computer's move, or 0 if not searching
 	Vector2 *arrDraggedPieceMoves;  // board coordinates (col, row)
 	Sprite *arrSprites;  // dynamic array of game sprites
 	Sprite *arrUISprites;  // dynamic array of user interface Sprites
@@ -151,26 +127,11 @@ typedef struct GameContext
 	TileMapComponent *tmapBackground;
 } GameContext;
 
-NormalChess *NormalChessAlloc(int turn, NormalChessPiece **arrPieces);
-NormalChess *NormalChessInit(void);
-NormalChessKind NormalChessCurrentKing(const NormalChess *chess);
-NormalChessKind NormalChessEnemyKingKind(NormalChessKind k);
-NormalChessKind NormalChessKingKind(NormalChessKind k);
-NormalChessKind PieceKingOf(const NormalChessPiece *p);
-NormalChessMove NormalChessCreateCastleMove(NormalChess *chess, NormalChessPiece *p, int targetCol);
-NormalChessMove NormalChessCreateMove(NormalChess *chess, int startCol, int startRow, int targetCol,
-		int targetRow);
-NormalChessMove NormalChessCreatePawnMove(NormalChess *chess, NormalChessPiece *p, int targetCol,
-		int targetRow);
 NormalChessPiece *GameGetPieceAt(const GameContext *game, Vector2 screenPos);
 NormalChessPiece *GameGetValidSelectedPiece(const GameContext *game);
-NormalChessPiece *NormalChessGetPawnPromotion(NormalChess *chess);
-NormalChessPiece *NormalChessMoveGetObject(NormalChessMove move, NormalChessPiece **arrPieces);
 NormalChessPiece *NormalChessMoveGetObjectInfo(NormalChess *chess, NormalChessMove move,
 		NormalChessPiece **object, int *isCapture, int *isCastle);
-NormalChessPiece *NormalChessMoveGetSubject(NormalChessMove move, NormalChessPiece **arrPieces);
-NormalChessPiece *NormalChessPieceAlloc(NormalChessKind k, int row, int col);
-NormalChessPiece *PiecesGetAt(NormalChessPiece **arrPieces, int row, int col);
+NormalChessSearchLimits GameComputerSearchLimits(const GameContext *game);
 Rectangle GameGetBoardRect(const GameContext *game);
 Rectangle NormalChessKindToTextureRect(NormalChessKind k);
 Sprite *SpritesArrCreateNormalChess(GameContext *game);
@@ -179,31 +140,10 @@ Sprite *SpritesArrFindNormalChessSpriteFor(Sprite *arrSprites, NormalChessPiece
 Sprite *SpritesArrFindSpriteAt(Sprite *arrSprites, int x, int y);
 Vector2 *NormalChessCreatePieceMoveList(const NormalChess *c, NormalChessPiece *p);
 Vector2 *Vector2ArrFind(Vector2 *arrVectors, Vector2 val);
-const NormalChessPiece *PiecesFindKing(const NormalChessPiece **arrPieces, NormalChessKind k);
-const NormalChessPiece *PiecesGetAtConst(const NormalChessPiece **arrPieces, int row, int col);
 const char *GameStateToStr(GameState s);
-const char *NormalChessKindToStr(NormalChessKind k);
 const char *SpriteKindToStr(SpriteKind k);
 float Vector2DistanceSquared(Vector2 a, Vector2 b);
 int GameIsPointOnBoard(const GameContext *game, Vector2 screenPos);
-int NormalChessAllMovesContains(const NormalChess *c, NormalChessPiece *p, int row, int col);
-int NormalChessCanMove(NormalChess *chess);
-int NormalChessCanUsePiece(const NormalChess *chess, const NormalChessPiece *p);
-int NormalChessIsCheckmate(NormalChess *chess);
-int NormalChessIsGameOver(NormalChess *chess);
-int NormalChessIsKingInCheck(NormalChess *chess);
-int NormalChessIsStalemate(NormalChess *chess);
-int NormalChessMovesContains(const NormalChessPiece *p, int row, int col);
-int NormalChessPieceTeamEq(const NormalChessPiece *a, const NormalChessPiece *b);
-int NormalChessSpecialMovesContains(const NormalChess *chess, const NormalChessPiece *p, int row, int col);
-int NormalChessTeamEq(NormalChessKind a, NormalChessKind b);
-int PiecesCanTeamCaptureSpot(const NormalChessPiece **arrPieces, NormalChessKind team, int targetRow,
-		int targetCol);
-int PiecesCountAtConst(const NormalChessPiece **arrPieces, int row, int col);
-int PiecesIsPiecePinned(const NormalChessPiece **arrPieces, NormalChessPiece *p, int targetRow,
-		int targetCol);
-int PiecesMoveIsBlocked(const NormalChessPiece **arrPieces, const NormalChessPiece *p, int targetRow,
-		int targetCol);
 int SpriteButtonStateUpdate(ButtonState *bstate, Rectangle boundingBox);
 int SpriteButtonUpdate(Sprite *s);
 int SpriteIsUI(Sprite *s);
@@ -211,6 +151,9 @@ int SpriteKindIsUI(SpriteKind k);
 int UpdatePlayButtons(GameContext *game);
 void ClearMoveSquares(GameContext *game);
 void Draw(const GameContext *game);
+void DrawAnalysis(const GameContext *game);
+void DrawArrow(Vector2 start, Vector2 end, float thick, Color color);
+void DrawClock(const GameContext *game, NormalChessKind team, int x, int y);
 void DrawDebug(const GameContext *game);
 void DrawGameOver(const GameContext *game);
 void DrawMainMenu(const GameContext *game);
@@ -222,6 +165,7 @@ void DrawTextCentered(const char *text, int centerX, int centerY, int fontSize,
 void DrawTextureRecCentered(Texture2D tex, Rectangle slice, Rectangle bounds);
 void GameCleanup(GameContext *game);
 void GameCleanupState(GameContext *game);
+void GameDoComputerMoveNormalChess(GameContext *game, NormalChessMove move);
 void GameDoMoveNormalChess(GameContext *game, int targetCol, int targetRow);
 void GameEnterState(GameContext *game, GameState previous);
 void GameEnterStateGameOver(GameContext *game, GameState previous);
@@ -236,20 +180,10 @@ void GameLeaveStatePlay(GameContext *game, GameState next);
 void GameLeaveStatePlayAnimate(GameContext *game, GameState next);
 void GameLeaveStatePlayPromote(GameContext *game, GameState next);
 void GameResetState(GameContext *game);
+void GameStopComputer(GameContext *game);
 void GameSwitchState(GameContext *game, GameState newState);
 void IntClamp(int *value, int min, int max);
-void NormalChessDestroy(NormalChess *p);
-void NormalChessDoCastle(NormalChess *chess, NormalChessMove move);
-void NormalChessDoMove(NormalChess *chess, NormalChessMove move);
-void NormalChessDoPawnSpecial(NormalChess *chess, NormalChessMove move);
-void NormalChessFree(NormalChess *p);
-void NormalChessPieceFree(NormalChessPiece *p);
 void NormalChessPosToScreen(int row, int col, int x0, int y0, int tileSize, int *x, int *y);
-void NormalChessUpdateMovementFlags(NormalChess *chess, NormalChessMove move);
-void PiecesDoCapture(NormalChessPiece **arrPieces, int startRow, int startCol, int targetRow,
-		int targetCol);
-void PiecesDoMove(NormalChessPiece **arrPieces, int startRow, int startCol, int targetRow, int targetCol);
-void PiecesRemovePieceAt(NormalChessPiece **arrPieces, int row, int col);
 void PlayInitBackgroundTiles(GameContext *game);
 void PlayInitBoardTiles(GameContext *game);
 void ScreenSnapCoords(int pX, int pY, int x0, int y0, int tileSize, int *pX2, int *pY2);
@@ -260,7 +194,6 @@ void SpriteMoveToNormalChessPiece(Sprite *s, const GameContext *game);
 void SpriteSetAsNormalChessPiece(Sprite *s, NormalChessPiece *p);
 void SpritesArrRemoveSprite(Sprite **refArrSprites, Sprite *removeMe);
 void Test(void);
-void TestNormalChessMovesContains(void);
 void TileToScreen(int tX, int tY, int x0, int y0, int tileSize, int *pX, int *pY);
 void Update(GameContext *game);
 void UpdateDebug(GameContext *game);
@@ -268,6 +201,7 @@ void UpdateGameOver(GameContext *game);
 void UpdateMainMenu(GameContext *game);
 void UpdateMoveSquares(GameContext *game);
 void UpdatePlay(GameContext *game);
+void UpdatePlayAnalysis(GameContext *game);
 void UpdatePlayAnimate(GameContext *game);
 void UpdatePlayPromote(GameContext *game);
 
@@ -4,6 +4,8 @@
 #include "game.h"
 
 int main(void) {
+	BitboardInitTables();
+	NormalChessInitZobrist();
 	Test();
 	// Init:
 	const int screenWidth = 600;
@@ -17,6 +19,15 @@ int main(void) {
 		.ticks                = 0,
 		.stateTicks           = 0,
 		.normalChess          = NULL,
+		.isComputerPlaying    = 1, // or 0 for two players
+		.computerTeam         = BLACK_KING, // the player is white
+		.computerSeconds      = 1.0,
+		.computerThreads      = 4, // threads for each search on the engine thread
+		.clockStartSeconds    = 5 * 60.0, // or 0 for no clocks
+		.clockIncrement       = 3.0,
+		.engine               = NULL, // started below (unless the search runs on the main thread)
+		.slicedSearch         = NULL,
+		.computerSearchId     = 0,
 		.arrDraggedPieceMoves = NULL,
 		.refSelectedSprite    = NULL,
 		.arrSprites           = NULL,
@@ -40,6 +51,11 @@ int main(void) {
 		.soundResign          = LoadSound("sfx/resign.wav"),
 		.soundGameStart       = LoadSound("sfx/game start.wav"),
 	};
+#ifndef CHESS_SINGLE_THREAD
+	// The thread count has to be set before the engine thread can start a search.
+	EngineSetThreadCount(game.computerThreads);
+	game.engine = EngineWorkerStart();
+#endif
 	// Begin
 	GameEnterState(&game, GS_NONE);
 	// Main loop:
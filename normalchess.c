@@ -0,0 +1,2076 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "normalchess.h"
+
+#define abs(x) (((x) > 0)? (x) : -(x))
+
+// Bitboards of whole board columns, used to stop shifted bitboards from wrapping around the board.
+#define BB_COL_0 0x0101010101010101ULL
+#define BB_COL_1 (BB_COL_0 << 1)
+#define BB_COL_6 (BB_COL_0 << 6)
+#define BB_COL_7 (BB_COL_0 << 7)
+#define BB_ROW_0 0xFFULL
+#define BB_ROW_7 (BB_ROW_0 << 56)
+
+// Magic numbers for looking up rook and bishop attacks, indexed by square (see BitboardInitMagics).
+// These were found by trying random sparse numbers until one worked for the square.
+static const Bitboard rookMagicNumbers[64] =
+{
+	0x1080004008801020ULL, 0x0840092002C03000ULL, 0x1900200010400900ULL, 0x0880100008000480ULL,
+	0x4200100420080200ULL, 0x8100020100080400ULL, 0x0200040110886200ULL, 0x0200008040220411ULL,
+	0x0404800084400220ULL, 0x0000401000402000ULL, 0x0086001081220440ULL, 0x0408800800100280ULL,
+	0x000A001201040820ULL, 0x8848800200840080ULL, 0x4001000100040200ULL, 0x0442000102105084ULL,
+	0x9080010020804100ULL, 0x0040404000201009ULL, 0x0000808010002009ULL, 0x2200090021D00100ULL,
+	0x0008008008040080ULL, 0x0004004002010040ULL, 0x0011040008015042ULL, 0x00000A0001768104ULL,
+	0x0000800080204009ULL, 0x2010004140002001ULL, 0x9800200280100080ULL, 0x1000100080080080ULL,
+	0x0442000A00049020ULL, 0x2100040080020080ULL, 0x0800120400900148ULL, 0x0010040A00128541ULL,
+	0x2800804000800030ULL, 0x1010002000400041ULL, 0x4000200011004100ULL, 0x0610008410800800ULL,
+	0x0400802402800800ULL, 0xC100020080800400ULL, 0x0002000802000401ULL, 0x0182085882000401ULL,
+	0x0220204000808000ULL, 0x2860100040024022ULL, 0x0001002004110040ULL, 0x99101042000A0020ULL,
+	0x0004080004008080ULL, 0x0010040002008080ULL, 0x2012004881020004ULL, 0x8300842444820011ULL,
+	0x0088403882010200ULL, 0x0820400080210100ULL, 0x0110910040A00300ULL, 0x0801100280080480ULL,
+	0x0242009008200600ULL, 0x1002000489500200ULL, 0x0040800200010080ULL, 0x0091800041000080ULL,
+	0x0000209300488001ULL, 0x04C1002414824001ULL, 0x020020000B001041ULL, 0x7000100004200901ULL,
+	0x8002002004100802ULL, 0x30010002084C0007ULL, 0x0888221800813004ULL, 0x4000002840840112ULL
+};
+static const Bitboard bishopMagicNumbers[64] =
+{
+	0xA010041108003100ULL, 0x006082020A002900ULL, 0x6810010619200000ULL, 0x08281A0520000408ULL,
+	0x0001104001000400ULL, 0x0018901008048400ULL, 0x00040A0210245280ULL, 0x000200210808A402ULL,
+	0x9140048410821200ULL, 0x0800091010820041ULL, 0x20504804832202C0ULL, 0x0100091401081000ULL,
+	0x8021011140000012ULL, 0x0810020804450400ULL, 0x208B0542109008A2ULL, 0x0080084A08040204ULL,
+	0x0040E2A80811244CULL, 0x2505022008008108ULL, 0x0430220100420040ULL, 0x010A040420220040ULL,
+	0x1105000290400000ULL, 0x0093001200822120ULL, 0x4000A62048043004ULL, 0x280120048A015004ULL,
+	0x006090002A020814ULL, 0x44042000240800D0ULL, 0x01102800040A4400ULL, 0x1004080080220040ULL,
+	0x0001001011004024ULL, 0x0010044000805040ULL, 0x0914041200820100ULL, 0x0004821012821480ULL,
+	0x0024040500C05021ULL, 0x0088611002080200ULL, 0x0116080A00040020ULL, 0x4000020080080080ULL,
+	0x2450450140840040ULL, 0x0000880201484100ULL, 0x0222020404020092ULL, 0x8081110600002E00ULL,
+	0x2842101105000801ULL, 0x1100809008001025ULL, 0x00020202221C0400ULL, 0x0422014022009020ULL,
+	0x0210046102100C00ULL, 0xC004008082029102ULL, 0x00AA461801101200ULL, 0x0404080080201108ULL,
+	0x020542108C205002ULL, 0x0410544804100100ULL, 0x0040910841100000ULL, 0x0400200042021100ULL,
+	0x00004204850400C0ULL, 0x0200100410A42102ULL, 0x1040020801210102ULL, 0x0805040410420000ULL,
+	0x2884804130100200ULL, 0x800C262201242000ULL, 0x1058000194108800ULL, 0x0014221054420204ULL,
+	0x0104000012A02200ULL, 0x0200881003300100ULL, 0x0140400202840100ULL, 0x0402020801010201ULL
+};
+
+// Sliding piece attack tables, filled in once at startup by BitboardInitMagics.
+static BitboardMagic rookMagics[64];
+static BitboardMagic bishopMagics[64];
+static Bitboard magicAttacks[102400 + 5248]; // all rook attack sets, then all bishop attack sets
+static int magicsInitialized = 0;
+
+// Squares strictly between two squares on the same row, column or diagonal (see BitboardInitLines).
+static Bitboard betweenTable[64][64];
+// The whole row, column or diagonal through two squares (or nothing if they are not lined up).
+static Bitboard lineTable[64][64];
+
+// Random numbers for Zobrist keys (see NormalChessInitZobrist).
+static uint64_t zobristPieces[12][64];   // for each piece kind on each square
+static uint64_t zobristTurn;             // for when it is black's turn
+static uint64_t zobristCastle[64];       // for each packed value of the castling flags
+static uint64_t zobristDoublePawnCol[8]; // for each column of a double pawn move (for en passant)
+static int zobristInitialized = 0;
+
+const char *NormalChessKindToStr(NormalChessKind k)
+{
+	switch (k)
+	{
+		case WHITE_KING:   return "WHITE_KING";
+		case WHITE_QUEEN:  return "WHITE_QUEEN";
+		case WHITE_ROOK:   return "WHITE_ROOK";
+		case WHITE_BISHOP: return "WHITE_BISHOP";
+		case WHITE_KNIGHT: return "WHITE_KNIGHT";
+		case WHITE_PAWN:   return "WHITE_PAWN";
+		case BLACK_KING:   return "BLACK_KING";
+		case BLACK_QUEEN:  return "BLACK_QUEEN";
+		case BLACK_ROOK:   return "BLACK_ROOK";
+		case BLACK_BISHOP: return "BLACK_BISHOP";
+		case BLACK_KNIGHT: return "BLACK_KNIGHT";
+		case BLACK_PAWN:   return "BLACK_PAWN";
+		default:
+			return "(invalid NormalChessKind)";
+	}
+}
+
+// Get the king of a chess piece kind.
+NormalChessKind NormalChessKingKind(NormalChessKind k)
+{
+	switch (k)
+	{
+		case WHITE_KING:
+		case WHITE_QUEEN:
+		case WHITE_ROOK:
+		case WHITE_BISHOP:
+		case WHITE_KNIGHT:
+		case WHITE_PAWN:
+			return WHITE_KING;
+		case BLACK_KING:
+		case BLACK_QUEEN:
+		case BLACK_ROOK:
+		case BLACK_BISHOP:
+		case BLACK_KNIGHT:
+		case BLACK_PAWN:
+			return BLACK_KING;
+		default:
+			assert(0 && "invalid NormalChessKind");
+	}
+}
+
+NormalChessKind NormalChessEnemyKingKind(NormalChessKind k)
+{
+	return (NormalChessKingKind(k) == WHITE_KING)? BLACK_KING : WHITE_KING;
+}
+
+NormalChessKind PieceKingOf(const NormalChessPiece *p)
+{
+	assert(p);
+	return NormalChessKingKind(p->kind);
+}
+
+int NormalChessTeamEq(NormalChessKind a, NormalChessKind b)
+{
+	return NormalChessKingKind(a) == NormalChessKingKind(b);
+}
+
+int NormalChessPieceTeamEq(const NormalChessPiece *a, const NormalChessPiece *b)
+{
+	return a && b && NormalChessTeamEq(a->kind, b->kind);
+}
+
+NormalChessKind NormalChessCurrentKing(const NormalChess *chess)
+{
+	return (chess->turn % 2 == 0)? WHITE_KING : BLACK_KING;
+}
+
+int NormalChessCanUsePiece(const NormalChess *chess, const NormalChessPiece *p)
+{
+	return chess && p && NormalChessTeamEq(p->kind, NormalChessCurrentKing(chess));
+}
+
+// Next number from a xorshift64 random number generator.
+uint64_t ZobristRandom(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+// Fill in the random numbers used for Zobrist keys.
+// The numbers come from a fixed seed, so a position has the same key every time the game is run.
+// Must be called once at startup before any NormalChess is created.
+void NormalChessInitZobrist(void)
+{
+	uint64_t state = 0x9E3779B97F4A7C15ULL;
+	for (int k = 0; k < 12; k++)
+	{
+		for (int square = 0; square < 64; square++)
+		{
+			zobristPieces[k][square] = ZobristRandom(&state);
+		}
+	}
+	zobristTurn = ZobristRandom(&state);
+	// The key for "no castling flags set" is left as zero.
+	zobristCastle[0] = 0;
+	for (int flags = 1; flags < 64; flags++)
+	{
+		zobristCastle[flags] = ZobristRandom(&state);
+	}
+	for (int col = 0; col < 8; col++)
+	{
+		zobristDoublePawnCol[col] = ZobristRandom(&state);
+	}
+	zobristInitialized = 1;
+}
+
+// Get the part of the Zobrist key for a piece on a square.
+uint64_t NormalChessKeyPiece(NormalChessKind k, int row, int col)
+{
+	assert(zobristInitialized);
+	return zobristPieces[k][row * 8 + col];
+}
+
+// Get the part of the Zobrist key for the castling flags, en passant, and the turn.
+uint64_t NormalChessKeyState(const NormalChess *chess)
+{
+	assert(chess);
+	assert(zobristInitialized);
+	uint64_t key = zobristCastle[chess->castleFlags];
+	if (chess->doublePawnCol >= 0)
+	{
+		key ^= zobristDoublePawnCol[chess->doublePawnCol];
+	}
+	if (chess->turn % 2)
+	{
+		key ^= zobristTurn;
+	}
+	return key;
+}
+
+// Compute the Zobrist key for a position from scratch.
+// The key is normally kept up to date in NormalChess by the functions that change it.
+uint64_t NormalChessComputeKey(const NormalChess *chess)
+{
+	assert(chess);
+	uint64_t key = NormalChessKeyState(chess);
+	for (int k = 0; k < 12; k++)
+	{
+		Bitboard pieces = chess->board.bbPieces[k];
+		while (pieces)
+		{
+			int square = BitboardFirstSquare(pieces);
+			pieces &= pieces - 1;
+			key ^= NormalChessKeyPiece(k, square / 8, square % 8);
+		}
+	}
+	return key;
+}
+
+// Allocates new, with an empty board.
+NormalChess *NormalChessAlloc(void)
+{
+	NormalChess *new = malloc(sizeof(*new));
+	assert(new);
+	NormalChessClear(new);
+	return new;
+}
+
+// Allocates a new copy of a game.
+NormalChess *NormalChessClone(const NormalChess *chess)
+{
+	assert(chess);
+	NormalChess *new = malloc(sizeof(*new));
+	assert(new);
+	*new = *chess;
+	return new;
+}
+
+void NormalChessFree(NormalChess *p)
+{
+	free(p);
+}
+
+// Reset a game to have an empty board and no moves done.
+// Pieces should be added with NormalChessAddPiece, and then NormalChessUpdateAll called.
+void NormalChessClear(NormalChess *chess)
+{
+	assert(chess);
+	chess->turn = 0;
+	chess->doublePawnCol = -1;
+	chess->castleFlags = 0;
+	chess->halfMoveClock = 0;
+	NormalChessBoardClear(&chess->board);
+	chess->pieceCount = 0;
+	memset(chess->squarePieces, -1, sizeof(chess->squarePieces));
+}
+
+// Add a new piece to the pool and put it on the board (at an empty square).
+// Returns: the piece, which stays at the same place in the pool for the rest of the game.
+NormalChessPiece *NormalChessAddPiece(NormalChess *chess, NormalChessKind k, int row, int col)
+{
+	assert(chess);
+	assert(chess->pieceCount < NORMAL_CHESS_MAX_PIECES);
+	assert(chess->squarePieces[row * 8 + col] < 0);
+	int i = chess->pieceCount++;
+	chess->pieces[i] = (NormalChessPiece){ .kind = k, .row = row, .col = col };
+	chess->squarePieces[row * 8 + col] = i;
+	NormalChessBoardPut(&chess->board, k, row, col);
+	return &chess->pieces[i];
+}
+
+// Update the attack maps and the key after the pieces and flags have been set up from scratch.
+void NormalChessUpdateAll(NormalChess *chess)
+{
+	assert(chess);
+	NormalChessUpdateAttacks(chess);
+	chess->key = NormalChessComputeKey(chess);
+}
+
+// Set up the pieces for the start of a game (without allocating anything).
+void NormalChessSetUp(NormalChess *chess)
+{
+	static const NormalChessKind backRow[8] =
+	{
+		WHITE_ROOK, WHITE_KNIGHT, WHITE_BISHOP, WHITE_QUEEN,
+		WHITE_KING, WHITE_BISHOP, WHITE_KNIGHT, WHITE_ROOK
+	};
+	NormalChessClear(chess);
+	// Create the pawn ranks
+	for (int col = 0; col < 8; col++)
+	{
+		NormalChessAddPiece(chess, WHITE_PAWN, 1, col);
+		NormalChessAddPiece(chess, BLACK_PAWN, 6, col);
+	}
+	// White pieces
+	for (int col = 0; col < 8; col++)
+	{
+		NormalChessAddPiece(chess, backRow[col], 0, col);
+	}
+	// Black pieces
+	for (int col = 0; col < 8; col++)
+	{
+		NormalChessAddPiece(chess, NormalChessKindForTeam(backRow[col], BLACK_KING), 7, col);
+	}
+	NormalChessUpdateAll(chess);
+}
+
+// Allocates new, set up for the start of a game.
+NormalChess *NormalChessInit(void)
+{
+	NormalChess *new = NormalChessAlloc();
+	NormalChessSetUp(new);
+	return new;
+}
+
+void NormalChessDestroy(NormalChess *p)
+{
+	NormalChessFree(p);
+}
+
+// Bitboard with only the square at (row, col) set.
+Bitboard BitboardAt(int row, int col)
+{
+	assert(row >= 0 && row <= 7);
+	assert(col >= 0 && col <= 7);
+	return ((Bitboard)1) << (row * 8 + col);
+}
+
+int BitboardPopCount(Bitboard b)
+{
+	return __builtin_popcountll(b);
+}
+
+// Get the square index (row * 8 + col) of the lowest square in a bitboard.
+// The bitboard must not be empty.
+int BitboardFirstSquare(Bitboard b)
+{
+	assert(b);
+	return __builtin_ctzll(b);
+}
+
+// Squares attacked by all of the knights in a bitboard.
+Bitboard BitboardKnightAttacks(Bitboard knights)
+{
+	Bitboard left1 = (knights >> 1) & ~BB_COL_7;
+	Bitboard left2 = (knights >> 2) & ~(BB_COL_6 | BB_COL_7);
+	Bitboard right1 = (knights << 1) & ~BB_COL_0;
+	Bitboard right2 = (knights << 2) & ~(BB_COL_0 | BB_COL_1);
+	Bitboard horizontal1 = left1 | right1;
+	Bitboard horizontal2 = left2 | right2;
+	return (horizontal1 << 16) | (horizontal1 >> 16) | (horizontal2 << 8) | (horizontal2 >> 8);
+}
+
+// Squares attacked by all of the kings in a bitboard.
+Bitboard BitboardKingAttacks(Bitboard kings)
+{
+	Bitboard attacks = ((kings << 1) & ~BB_COL_0) | ((kings >> 1) & ~BB_COL_7);
+	kings |= attacks;
+	return attacks | (kings << 8) | (kings >> 8);
+}
+
+// Squares attacked (diagonally) by all of the pawns in a bitboard.
+// White pawns attack up the board (increasing row) and black pawns attack down the board.
+Bitboard BitboardPawnAttacks(Bitboard pawns, NormalChessKind team)
+{
+	if (NormalChessKingKind(team) == WHITE_KING)
+	{
+		return ((pawns << 7) & ~BB_COL_7) | ((pawns << 9) & ~BB_COL_0);
+	}
+	else
+	{
+		return ((pawns >> 9) & ~BB_COL_7) | ((pawns >> 7) & ~BB_COL_0);
+	}
+}
+
+// Trace a sliding piece's path from a square in one direction. The path stops at (and includes)
+// the first occupied square.
+Bitboard BitboardSlideAttacks(int square, Bitboard occupied, int dRow, int dCol)
+{
+	Bitboard attacks = 0;
+	int row = square / 8 + dRow;
+	int col = square % 8 + dCol;
+	while (row >= 0 && row <= 7 && col >= 0 && col <= 7)
+	{
+		Bitboard b = BitboardAt(row, col);
+		attacks |= b;
+		if (occupied & b)
+		{
+			break;
+		}
+		row += dRow;
+		col += dCol;
+	}
+	return attacks;
+}
+
+// Slow version of BitboardRookAttacks, used for filling in the magic attack tables.
+Bitboard BitboardRookRays(int square, Bitboard occupied)
+{
+	return BitboardSlideAttacks(square, occupied, 1, 0)
+		| BitboardSlideAttacks(square, occupied, -1, 0)
+		| BitboardSlideAttacks(square, occupied, 0, 1)
+		| BitboardSlideAttacks(square, occupied, 0, -1);
+}
+
+// Slow version of BitboardBishopAttacks, used for filling in the magic attack tables.
+Bitboard BitboardBishopRays(int square, Bitboard occupied)
+{
+	return BitboardSlideAttacks(square, occupied, 1, 1)
+		| BitboardSlideAttacks(square, occupied, 1, -1)
+		| BitboardSlideAttacks(square, occupied, -1, 1)
+		| BitboardSlideAttacks(square, occupied, -1, -1);
+}
+
+// Fill in the attack table for one square of a sliding piece.
+// Returns: the number of table entries used.
+int BitboardInitMagic(BitboardMagic *m, int square, int isRook, Bitboard *attacks)
+{
+	if (isRook)
+	{
+		// The edge squares at the end of each ray never block anything, so leave them out.
+		m->mask = (BitboardSlideAttacks(square, 0, 1, 0) & ~BB_ROW_7)
+			| (BitboardSlideAttacks(square, 0, -1, 0) & ~BB_ROW_0)
+			| (BitboardSlideAttacks(square, 0, 0, 1) & ~BB_COL_7)
+			| (BitboardSlideAttacks(square, 0, 0, -1) & ~BB_COL_0);
+		m->magic = rookMagicNumbers[square];
+	}
+	else
+	{
+		m->mask = BitboardBishopRays(square, 0) & ~(BB_ROW_0 | BB_ROW_7 | BB_COL_0 | BB_COL_7);
+		m->magic = bishopMagicNumbers[square];
+	}
+	m->shift = 64 - BitboardPopCount(m->mask);
+	m->attacks = attacks;
+	// Go through every subset of the mask squares (every way the mask could be occupied).
+	Bitboard occupied = 0;
+	do
+	{
+		Bitboard result = isRook? BitboardRookRays(square, occupied)
+			: BitboardBishopRays(square, occupied);
+		Bitboard *entry = &m->attacks[((occupied & m->mask) * m->magic) >> m->shift];
+		// Different occupancies may share an entry only if they have the same attacks.
+		assert(*entry == 0 || *entry == result);
+		*entry = result;
+		occupied = (occupied - m->mask) & m->mask;
+	}
+	while (occupied);
+	return 1 << (64 - m->shift);
+}
+
+// Fill in the rook and bishop attack tables.
+void BitboardInitMagics(void)
+{
+	if (magicsInitialized)
+	{
+		return;
+	}
+	int used = 0;
+	for (int square = 0; square < 64; square++)
+	{
+		used += BitboardInitMagic(&rookMagics[square], square, 1, magicAttacks + used);
+	}
+	for (int square = 0; square < 64; square++)
+	{
+		used += BitboardInitMagic(&bishopMagics[square], square, 0, magicAttacks + used);
+	}
+	assert(used == sizeof(magicAttacks) / sizeof(magicAttacks[0]));
+	magicsInitialized = 1;
+}
+
+// Fill in the tables for squares between and through pairs of squares.
+// The magic attack tables must already be filled in.
+void BitboardInitLines(void)
+{
+	assert(magicsInitialized);
+	for (int a = 0; a < 64; a++)
+	{
+		for (int b = 0; b < 64; b++)
+		{
+			Bitboard bitA = ((Bitboard)1) << a;
+			Bitboard bitB = ((Bitboard)1) << b;
+			betweenTable[a][b] = 0;
+			lineTable[a][b] = 0;
+			if (a == b)
+			{
+				continue;
+			}
+			if (BitboardRookAttacks(a, 0) & bitB)
+			{
+				betweenTable[a][b] = BitboardRookAttacks(a, bitB) & BitboardRookAttacks(b, bitA);
+				lineTable[a][b] = (BitboardRookAttacks(a, 0) & BitboardRookAttacks(b, 0)) | bitA | bitB;
+			}
+			else if (BitboardBishopAttacks(a, 0) & bitB)
+			{
+				betweenTable[a][b] = BitboardBishopAttacks(a, bitB) & BitboardBishopAttacks(b, bitA);
+				lineTable[a][b] = (BitboardBishopAttacks(a, 0) & BitboardBishopAttacks(b, 0))
+					| bitA | bitB;
+			}
+		}
+	}
+}
+
+// Fill in all of the lookup tables for bitboards.
+// Must be called once at startup before any chess rules are checked.
+void BitboardInitTables(void)
+{
+	BitboardInitMagics();
+	BitboardInitLines();
+}
+
+// Squares strictly between two squares which are on the same row, column, or diagonal.
+// Returns an empty bitboard if the squares are not lined up.
+Bitboard BitboardBetween(int a, int b)
+{
+	return betweenTable[a][b];
+}
+
+// All of the squares on the row, column, or diagonal through two squares (from one edge of the
+// board to the other). Returns an empty bitboard if the squares are not lined up.
+Bitboard BitboardLine(int a, int b)
+{
+	return lineTable[a][b];
+}
+
+// Squares attacked by a rook on a square, stopping at the first occupied square in each direction.
+Bitboard BitboardRookAttacks(int square, Bitboard occupied)
+{
+	assert(magicsInitialized);
+	const BitboardMagic *m = &rookMagics[square];
+	return m->attacks[((occupied & m->mask) * m->magic) >> m->shift];
+}
+
+// Squares attacked by a bishop on a square, stopping at the first occupied square in each
+// direction.
+Bitboard BitboardBishopAttacks(int square, Bitboard occupied)
+{
+	assert(magicsInitialized);
+	const BitboardMagic *m = &bishopMagics[square];
+	return m->attacks[((occupied & m->mask) * m->magic) >> m->shift];
+}
+
+// Index into NormalChessBoard.bbTeams for a piece kind's team.
+int NormalChessTeamIndex(NormalChessKind k)
+{
+	return (NormalChessKingKind(k) == WHITE_KING)? 0 : 1;
+}
+
+// Get the same kind of piece as k, but for the team of the given piece kind.
+// Example: NormalChessKindForTeam(WHITE_ROOK, BLACK_PAWN) is BLACK_ROOK.
+NormalChessKind NormalChessKindForTeam(NormalChessKind k, NormalChessKind team)
+{
+	return NormalChessKingKind(team) + (k - NormalChessKingKind(k));
+}
+
+void NormalChessBoardClear(NormalChessBoard *board)
+{
+	assert(board);
+	memset(board, 0, sizeof(*board));
+}
+
+// Add a piece to an empty square.
+void NormalChessBoardPut(NormalChessBoard *board, NormalChessKind k, int row, int col)
+{
+	assert(board);
+	assert(WHITE_KING <= k && k <= BLACK_PAWN);
+	Bitboard b = BitboardAt(row, col);
+	assert(!(NormalChessBoardOccupied(board) & b));
+	board->bbPieces[k] |= b;
+	board->bbTeams[NormalChessTeamIndex(k)] |= b;
+}
+
+// Remove whatever piece is on a square (if any).
+void NormalChessBoardRemove(NormalChessBoard *board, int row, int col)
+{
+	assert(board);
+	Bitboard keep = ~BitboardAt(row, col);
+	for (int k = WHITE_KING; k <= BLACK_PAWN; k++)
+	{
+		board->bbPieces[k] &= keep;
+	}
+	board->bbTeams[0] &= keep;
+	board->bbTeams[1] &= keep;
+}
+
+// Returns: the NormalChessKind on a square, or -1 if the square is empty.
+int NormalChessBoardKindAt(const NormalChessBoard *board, int row, int col)
+{
+	assert(board);
+	Bitboard b = BitboardAt(row, col);
+	int king;
+	if (board->bbTeams[0] & b)
+	{
+		king = WHITE_KING;
+	}
+	else if (board->bbTeams[1] & b)
+	{
+		king = BLACK_KING;
+	}
+	else
+	{
+		return -1;
+	}
+	// Only need to check the piece bitboards for the one team.
+	for (int k = king; k <= king + (WHITE_PAWN - WHITE_KING); k++)
+	{
+		if (board->bbPieces[k] & b)
+		{
+			return k;
+		}
+	}
+	assert(0 && "team bitboard is out of sync with the piece bitboards");
+	return -1;
+}
+
+Bitboard NormalChessBoardOccupied(const NormalChessBoard *board)
+{
+	return board->bbTeams[0] | board->bbTeams[1];
+}
+
+// Find the location of the king of a piece kind's team.
+// Returns: 1 if the king was found and 0 otherwise.
+int NormalChessBoardFindKing(const NormalChessBoard *board, NormalChessKind k, int *row, int *col)
+{
+	assert(board);
+	Bitboard kings = board->bbPieces[NormalChessKingKind(k)];
+	if (!kings)
+	{
+		return 0;
+	}
+	int square = BitboardFirstSquare(kings);
+	*row = square / 8;
+	*col = square % 8;
+	return 1;
+}
+
+// Squares that a piece of kind k at (row, col) attacks, with sliding pieces being blocked by the
+// other pieces on the board. For pawns, this is only the diagonal capturing squares.
+Bitboard NormalChessBoardAttacks(const NormalChessBoard *board, NormalChessKind k, int row, int col)
+{
+	assert(board);
+	int square = row * 8 + col;
+	Bitboard occupied = NormalChessBoardOccupied(board);
+	switch (k)
+	{
+		case WHITE_KING:
+		case BLACK_KING:
+			return BitboardKingAttacks(BitboardAt(row, col));
+		case WHITE_QUEEN:
+		case BLACK_QUEEN:
+			return BitboardRookAttacks(square, occupied) | BitboardBishopAttacks(square, occupied);
+		case WHITE_ROOK:
+		case BLACK_ROOK:
+			return BitboardRookAttacks(square, occupied);
+		case WHITE_BISHOP:
+		case BLACK_BISHOP:
+			return BitboardBishopAttacks(square, occupied);
+		case WHITE_KNIGHT:
+		case BLACK_KNIGHT:
+			return BitboardKnightAttacks(BitboardAt(row, col));
+		case WHITE_PAWN:
+		case BLACK_PAWN:
+			return BitboardPawnAttacks(BitboardAt(row, col), k);
+		default:
+			assert(0 && "invalid chess piece kind");
+			return 0;
+	}
+}
+
+// Take the piece at the given row and column off of the board, without freeing it.
+// Returns: the piece, which keeps its place in the pool (so it can be put back later), or NULL if
+// there is no piece there.
+NormalChessPiece *PiecesTakePieceAt(NormalChess *chess, int row, int col)
+{
+	assert(chess);
+	NormalChessPiece *p = PiecesGetAt(chess, row, col);
+	if (!p)
+	{
+		return NULL;
+	}
+	NormalChessBoardRemove(&chess->board, row, col);
+	chess->key ^= NormalChessKeyPiece(p->kind, row, col);
+	chess->squarePieces[row * 8 + col] = -1;
+	return p;
+}
+
+// Put a piece taken with PiecesTakePieceAt back on to its (empty) square.
+void PiecesPutPiece(NormalChess *chess, NormalChessPiece *p)
+{
+	assert(chess);
+	assert(p);
+	NormalChessBoardPut(&chess->board, p->kind, p->row, p->col);
+	chess->key ^= NormalChessKeyPiece(p->kind, p->row, p->col);
+	chess->squarePieces[p->row * 8 + p->col] = p - chess->pieces;
+}
+
+// Removes any pieces with the given row and column.
+void PiecesRemovePieceAt(NormalChess *chess, int row, int col)
+{
+	PiecesTakePieceAt(chess, row, col);
+}
+
+// Check whether a piece from the pool is on the board (it is not if it was captured).
+int PiecesIsOnBoard(const NormalChess *chess, const NormalChessPiece *p)
+{
+	assert(chess);
+	assert(p);
+	return chess->squarePieces[p->row * 8 + p->col] == p - chess->pieces;
+}
+
+// Get the piece at the given location.
+// Returns NULL if no piece is found.
+NormalChessPiece *PiecesGetAt(const NormalChess *chess, int row, int col)
+{
+	assert(chess);
+	assert(row >= 0 && row <= 7);
+	assert(col >= 0 && col <= 7);
+	int i = chess->squarePieces[row * 8 + col];
+	return (i >= 0)? (NormalChessPiece *)&chess->pieces[i] : NULL;
+}
+
+// Change the kind of a piece (for pawn promotion).
+void NormalChessPromotePiece(NormalChess *chess, NormalChessPiece *p, NormalChessKind k)
+{
+	assert(chess);
+	assert(p);
+	NormalChessBoardRemove(&chess->board, p->row, p->col);
+	NormalChessBoardPut(&chess->board, k, p->row, p->col);
+	chess->key ^= NormalChessKeyPiece(p->kind, p->row, p->col)
+		^ NormalChessKeyPiece(k, p->row, p->col);
+	p->kind = k;
+}
+
+NormalChessPiece *NormalChessGetPawnPromotion(NormalChess *chess)
+{
+	assert(chess);
+	// White pawn must reach row 7.
+	// Black pawn must reach row 0.
+	// (The turn has already gone to the other team when the pawn is waiting to be promoted.)
+	Bitboard promoting = (chess->board.bbPieces[WHITE_PAWN] & BB_ROW_7)
+		| (chess->board.bbPieces[BLACK_PAWN] & BB_ROW_0);
+	if (!promoting)
+	{
+		return NULL;
+	}
+	int square = BitboardFirstSquare(promoting);
+	return PiecesGetAt(chess, square / 8, square % 8);
+}
+
+NormalChessPiece *NormalChessMoveGetSubject(NormalChessMove move, const NormalChess *chess)
+{
+	if (move == NORMAL_CHESS_NO_MOVE)
+	{
+		return NULL;
+	}
+	int subject = NormalChessMoveSubject(move);
+	return PiecesGetAt(chess, subject / 8, subject % 8);
+}
+
+NormalChessPiece *NormalChessMoveGetObject(NormalChessMove move, const NormalChess *chess)
+{
+	int object = NormalChessMoveObjectSquare(move);
+	if (object < 0)
+	{
+		return NULL;
+	}
+	return PiecesGetAt(chess, object / 8, object % 8);
+}
+
+// Move the piece at start to target
+// (there should not be a piece already at target).
+void PiecesDoMove(NormalChess *chess, int startRow, int startCol, int targetRow, int targetCol)
+{
+	assert(chess);
+	// There should not be a piece at the target location.
+	assert(NormalChessBoardKindAt(&chess->board, targetRow, targetCol) < 0);
+	// Find the piece in the array at the location and move it
+	NormalChessPiece *p = PiecesGetAt(chess, startRow, startCol);
+	assert(p);
+	NormalChessBoardRemove(&chess->board, startRow, startCol);
+	NormalChessBoardPut(&chess->board, p->kind, targetRow, targetCol);
+	chess->key ^= NormalChessKeyPiece(p->kind, startRow, startCol)
+		^ NormalChessKeyPiece(p->kind, targetRow, targetCol);
+	chess->squarePieces[targetRow * 8 + targetCol] = chess->squarePieces[startRow * 8 + startCol];
+	chess->squarePieces[startRow * 8 + startCol] = -1;
+	p->row = targetRow;
+	p->col = targetCol;
+}
+
+// Remove the piece at target and move the piece at start to the target.
+void PiecesDoCapture(NormalChess *chess, int startRow, int startCol, int targetRow, int targetCol)
+{
+	assert(chess);
+	PiecesRemovePieceAt(chess, targetRow, targetCol);
+	PiecesDoMove(chess, startRow, startCol, targetRow, targetCol);
+}
+
+// Returns if a piece could possibly move to the given location.
+int NormalChessMovesContains(const NormalChessPiece *p, int row, int col)
+{
+	int dRow = row - p->row;
+	int dCol = col - p->col;
+	// Pieces cannot move to their own square
+	if (dRow == 0 && dCol == 0)
+	{
+		return 0;
+	}
+	switch (p->kind)
+	{
+		case WHITE_KING:
+		case BLACK_KING:
+			// # # #
+			// # * #
+			// # # #
+			return (abs(dRow) <= 1) && (abs(dCol) <= 1);
+		case WHITE_QUEEN:
+		case BLACK_QUEEN:
+			// # . . # . . #
+			// . # . # . # .
+			// . . # # # . .
+			// # # # * # # #
+			// . . # # # . .
+			// . # . # . # .
+			// # . . # . . #
+			// Rook || Bishop
+			return (dRow == 0 || dCol == 0)
+				|| (abs(dRow) == abs(dCol));
+		case WHITE_ROOK:
+		case BLACK_ROOK:
+			// . . . # . . .
+			// . . . # . . .
+			// . . . # . . .
+			// # # # * # # #
+			// . . . # . . .
+			// . . . # . . .
+			// . . . # . . .
+			return dRow == 0 || dCol == 0;
+		case WHITE_BISHOP:
+		case BLACK_BISHOP:
+			// # . . . . . #
+			// . # . . . # .
+			// . . # . # . .
+			// . . . * . . .
+			// . . # . # . .
+			// . # . . . # .
+			// # . . . . . #
+			return abs(dRow) == abs(dCol);
+		case WHITE_KNIGHT:
+		case BLACK_KNIGHT:
+			// . . # . # . .
+			// . # . . . # .
+			// . . . * . . .
+			// . # . . . # .
+			// . . # . # . .
+			return (abs(dRow) == 2 && abs(dCol) == 1)
+				|| (abs(dRow) == 1 && abs(dCol) == 2);
+		case WHITE_PAWN:
+			// # # #
+			// . * .
+			// . . .
+			return dRow == 1 && abs(dCol) <= 1;
+		case BLACK_PAWN:
+			// . . .
+			// . * .
+			// # # #
+			return dRow == -1 && abs(dCol) <= 1;
+		default:
+			assert(0 && "invalid chess piece kind");
+	}
+}
+
+// Returns whether any piece on the team can capture a piece on the target square.
+// Note: special moves are not checked.
+int PiecesCanTeamCaptureSpot(const NormalChessBoard *board, NormalChessKind team, int targetRow,
+		int targetCol)
+{
+	assert(board);
+	return NormalChessBoardAttackersOf(board, team, targetRow * 8 + targetCol,
+			NormalChessBoardOccupied(board)) != 0;
+}
+
+// Get the pieces on a team which attack a square. The occupied squares are given separately from
+// the board so that sliding pieces can be made to "see through" a piece (like a king moving away
+// from a sliding piece along its line of attack).
+Bitboard NormalChessBoardAttackersOf(const NormalChessBoard *board, NormalChessKind team,
+		int square, Bitboard occupied)
+{
+	assert(board);
+	// Pieces other than pawns capture the same way in every direction, so look outwards from the
+	// target square with each piece's movement pattern to find the pieces that reach it.
+	Bitboard target = ((Bitboard)1) << square;
+	const Bitboard *bbPieces = board->bbPieces;
+	Bitboard queens = bbPieces[NormalChessKindForTeam(WHITE_QUEEN, team)];
+	Bitboard rooks = bbPieces[NormalChessKindForTeam(WHITE_ROOK, team)] | queens;
+	Bitboard bishops = bbPieces[NormalChessKindForTeam(WHITE_BISHOP, team)] | queens;
+	Bitboard knights = bbPieces[NormalChessKindForTeam(WHITE_KNIGHT, team)];
+	Bitboard pawns = bbPieces[NormalChessKindForTeam(WHITE_PAWN, team)];
+	Bitboard kings = bbPieces[NormalChessKingKind(team)];
+	// A pawn captures the target if an enemy pawn on the target would capture the pawn.
+	return (BitboardPawnAttacks(target, NormalChessEnemyKingKind(team)) & pawns)
+		| (BitboardKnightAttacks(target) & knights)
+		| (BitboardKingAttacks(target) & kings)
+		| (BitboardRookAttacks(square, occupied) & rooks)
+		| (BitboardBishopAttacks(square, occupied) & bishops);
+}
+
+// Get all of the squares which a team's pieces attack. The occupied squares are given separately
+// from the board (see NormalChessBoardAttackersOf).
+Bitboard NormalChessBoardTeamAttacks(const NormalChessBoard *board, NormalChessKind team,
+		Bitboard occupied)
+{
+	assert(board);
+	const Bitboard *bbPieces = board->bbPieces;
+	Bitboard queens = bbPieces[NormalChessKindForTeam(WHITE_QUEEN, team)];
+	Bitboard rooks = bbPieces[NormalChessKindForTeam(WHITE_ROOK, team)] | queens;
+	Bitboard bishops = bbPieces[NormalChessKindForTeam(WHITE_BISHOP, team)] | queens;
+	// Pawns, knights, and kings can all be done at once because they do not slide.
+	Bitboard result = BitboardPawnAttacks(bbPieces[NormalChessKindForTeam(WHITE_PAWN, team)], team)
+		| BitboardKnightAttacks(bbPieces[NormalChessKindForTeam(WHITE_KNIGHT, team)])
+		| BitboardKingAttacks(bbPieces[team]);
+	while (rooks)
+	{
+		result |= BitboardRookAttacks(BitboardFirstSquare(rooks), occupied);
+		rooks &= rooks - 1;
+	}
+	while (bishops)
+	{
+		result |= BitboardBishopAttacks(BitboardFirstSquare(bishops), occupied);
+		bishops &= bishops - 1;
+	}
+	return result;
+}
+
+// Update the squares attacked by each team after the board has changed.
+// Each team's attacks look through the other team's king, so that a king cannot step backwards
+// along the line of a sliding piece which is checking it.
+void NormalChessUpdateAttacks(NormalChess *chess)
+{
+	assert(chess);
+	const NormalChessBoard *board = &chess->board;
+	Bitboard occupied = NormalChessBoardOccupied(board);
+	chess->bbAttacks[0] = NormalChessBoardTeamAttacks(board, WHITE_KING,
+			occupied & ~board->bbPieces[BLACK_KING]);
+	chess->bbAttacks[1] = NormalChessBoardTeamAttacks(board, BLACK_KING,
+			occupied & ~board->bbPieces[WHITE_KING]);
+}
+
+// Returns whether a team attacks a square, using the attack maps kept in NormalChess.
+int NormalChessIsSquareAttacked(const NormalChess *chess, NormalChessKind team, int row, int col)
+{
+	assert(chess);
+	return (chess->bbAttacks[NormalChessTeamIndex(team)] & BitboardAt(row, col)) != 0;
+}
+
+// Check the castling rules for a king on either the king's side or the queen's side.
+// The king and the rook must not have moved, the squares between them must be empty, and the king
+// cannot castle out of, through, or into check.
+int NormalChessCanCastle(const NormalChess *chess, const NormalChessPiece *king, int isKingsSide)
+{
+	assert(chess);
+	assert(king);
+	int hasKingMoved, hasRookMoved, homeRow;
+	switch (king->kind)
+	{
+		case WHITE_KING:
+			hasKingMoved = chess->castleFlags & CF_WHITE_KING_MOVED;
+			hasRookMoved = chess->castleFlags
+				& (isKingsSide? CF_WHITE_KINGS_ROOK_MOVED : CF_WHITE_QUEENS_ROOK_MOVED);
+			homeRow = 0;
+			break;
+		case BLACK_KING:
+			hasKingMoved = chess->castleFlags & CF_BLACK_KING_MOVED;
+			hasRookMoved = chess->castleFlags
+				& (isKingsSide? CF_BLACK_KINGS_ROOK_MOVED : CF_BLACK_QUEENS_ROOK_MOVED);
+			homeRow = 7;
+			break;
+		default:
+			return 0;
+	}
+	const NormalChessBoard *board = &chess->board;
+	int rookCol = isKingsSide? 7 : 0;
+	int dCol = isKingsSide? 1 : -1;
+	if (hasKingMoved || hasRookMoved || king->row != homeRow || king->col != 4
+			|| NormalChessBoardKindAt(board, homeRow, rookCol)
+				!= (int)NormalChessKindForTeam(WHITE_ROOK, king->kind))
+	{
+		return 0;
+	}
+	// The squares between the king and the rook must be empty.
+	for (int col = king->col + dCol; col != rookCol; col += dCol)
+	{
+		if (NormalChessBoardOccupied(board) & BitboardAt(homeRow, col))
+		{
+			return 0;
+		}
+	}
+	// The king's start square, the square it passes, and its target square must not be attacked.
+	NormalChessKind enemyKing = NormalChessEnemyKingKind(king->kind);
+	for (int i = 0; i <= 2; i++)
+	{
+		if (NormalChessIsSquareAttacked(chess, enemyKing, homeRow, king->col + dCol * i))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void TestNormalChessMovesContains(void)
+{
+	// int NormalChessMovesContains(NormalChessPiece p, int row, int col);
+	NormalChessPiece p1;
+
+	p1 = (NormalChessPiece){ .kind = WHITE_PAWN, .row = 0, .col = 4 };
+	assert(!NormalChessMovesContains(&p1, 0, 4));
+
+	p1 = (NormalChessPiece){ .kind = BLACK_PAWN, .row = 7, .col = 3 };
+	assert(!NormalChessMovesContains(&p1, 7, 3));
+}
+
+void TestNormalChessBoard(void)
+{
+	NormalChess *chess = NormalChessInit();
+	const NormalChessBoard *board = &chess->board;
+	assert(BitboardPopCount(NormalChessBoardOccupied(board)) == 32);
+	assert(NormalChessBoardKindAt(board, 0, 4) == WHITE_KING);
+	assert(NormalChessBoardKindAt(board, 7, 3) == BLACK_QUEEN);
+	assert(NormalChessBoardKindAt(board, 3, 3) == -1);
+	// Pawns and knights guard the row in front of the pawns, but nothing reaches past that yet.
+	assert(PiecesCanTeamCaptureSpot(board, WHITE_KING, 2, 5));
+	assert(PiecesCanTeamCaptureSpot(board, BLACK_KING, 5, 0));
+	assert(!PiecesCanTeamCaptureSpot(board, WHITE_KING, 3, 4));
+	NormalChessDestroy(chess);
+	(void)board;
+}
+
+void TestNormalChessGenerateMoves(void)
+{
+	NormalChess *chess = NormalChessInit();
+	NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+	// 16 pawn moves (8 of them double moves) and 4 knight moves.
+	int count = NormalChessGenerateMoves(chess, moves);
+	assert(count == 20);
+	int doubleCount = 0;
+	for (int i = 0; i < count; i++)
+	{
+		doubleCount += NormalChessMoveFlags(moves[i]) == MF_DOUBLE_PAWN;
+		assert(!NormalChessMoveIsCapture(moves[i]));
+	}
+	assert(doubleCount == 8);
+	NormalChessMove m = NormalChessMoveFromSquares(52, 61, MF_CAPTURE | MF_PROMOTE_KNIGHT);
+	assert(NormalChessMoveSubject(m) == 52 && NormalChessMoveTarget(m) == 61);
+	assert(NormalChessMoveIsCapture(m) && NormalChessMoveObjectSquare(m) == 61);
+	assert(NormalChessMovePromoteKind(m, BLACK_KING) == BLACK_KNIGHT);
+	assert(NormalChessMoveObjectSquare(NormalChessMoveFromSquares(36, 43, MF_EN_PASSANT)) == 35);
+	(void)m;
+	// The noisy moves and the quiet moves are all of the moves between them, and each move is
+	// pseudo-legal (but not the same move from the other team's side, or with other flags).
+	int isOk = NormalChessSetUpFEN(chess,
+			"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+	assert(isOk);
+	(void)isOk;
+	count = NormalChessGenerateMoves(chess, moves);
+	NormalChessMove noisy[NORMAL_CHESS_MAX_MOVES];
+	NormalChessMove quiet[NORMAL_CHESS_MAX_MOVES];
+	int noisyCount = NormalChessGenerateMoveSet(chess, MS_NOISY, ~((Bitboard)0), noisy);
+	int quietCount = NormalChessGenerateMoveSet(chess, MS_QUIET, ~((Bitboard)0), quiet);
+	assert(noisyCount == 8 && noisyCount + quietCount == count);
+	for (int i = 0; i < count; i++)
+	{
+		int isNoisy = (NormalChessMoveFlags(moves[i]) & (MF_CAPTURE | MF_PROMOTE)) != 0;
+		int found = 0;
+		for (int j = 0; j < (isNoisy? noisyCount : quietCount); j++)
+		{
+			found |= (moves[i] == (isNoisy? noisy[j] : quiet[j]));
+		}
+		assert(found);
+		assert(NormalChessMoveIsPseudoLegal(chess, moves[i]));
+	}
+	assert(!NormalChessMoveIsPseudoLegal(chess, NormalChessMoveFromSquares(48, 40, MF_QUIET)));
+	assert(!NormalChessMoveIsPseudoLegal(chess, NormalChessMoveFromSquares(36, 44, MF_QUIET)));
+	assert(!NormalChessMoveIsPseudoLegal(chess, NormalChessMoveFromSquares(21, 45, MF_QUIET)));
+	NormalChessDestroy(chess);
+}
+
+// Every move should be taken back exactly by unmaking it.
+void TestNormalChessMakeMove(void)
+{
+	NormalChess *chess = NormalChessInit();
+	NormalChess before = *chess;
+	NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+	int count = NormalChessGenerateMoves(chess, moves);
+	for (int i = 0; i < count; i++)
+	{
+		NormalChessUndo undo;
+		NormalChessMakeMove(chess, moves[i], &undo);
+		assert(chess->turn == before.turn + 1);
+		assert(chess->key == NormalChessComputeKey(chess));
+		assert(chess->key != before.key);
+		int subject = NormalChessMoveSubject(moves[i]);
+		assert(NormalChessBoardKindAt(&chess->board, subject / 8, subject % 8) < 0);
+		NormalChessUnmakeMove(chess, moves[i], &undo);
+		assert(!memcmp(&chess->board, &before.board, sizeof(before.board)));
+		assert(!memcmp(chess->squarePieces, before.squarePieces, sizeof(before.squarePieces)));
+		assert(!memcmp(chess->pieces, before.pieces, sizeof(before.pieces)));
+		assert(chess->turn == before.turn);
+		assert(chess->doublePawnCol == before.doublePawnCol);
+		assert(!memcmp(chess->bbAttacks, before.bbAttacks, sizeof(before.bbAttacks)));
+		assert(chess->key == before.key);
+		(void)subject;
+	}
+	(void)before;
+	NormalChessDestroy(chess);
+}
+
+void TestNormalChessCheckInfo(void)
+{
+	assert(BitboardPopCount(BitboardBetween(0, 63)) == 6);
+	assert(BitboardPopCount(BitboardLine(9, 18)) == 8);
+	assert(!BitboardBetween(0, 10));
+	NormalChess *chess = NormalChessInit();
+	NormalChessCheckInfo info;
+	NormalChessGetCheckInfo(chess, &info);
+	assert(info.kingSquare == 4);
+	assert(!info.checkers);
+	assert(!info.pinned);
+	assert(chess->bbAttacks[0] == ((BB_ROW_0 ^ BitboardAt(0, 0) ^ BitboardAt(0, 7))
+			| (BB_ROW_0 << 8) | (BB_ROW_0 << 16)));
+	NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+	int count = NormalChessGenerateLegalMoves(chess, moves);
+	assert(count == 20);
+	(void)count;
+	NormalChessDestroy(chess);
+}
+
+void TestNormalChessClone(void)
+{
+	NormalChess *chess = NormalChessInit();
+	NormalChess *clone = NormalChessClone(chess);
+	assert(clone->key == chess->key);
+	assert(PiecesGetAt(clone, 0, 4) == &clone->pieces[PiecesGetAt(chess, 0, 4) - chess->pieces]);
+	// Copy-make some moves on a stack of positions, and check them against make/unmake.
+	const char *moveStrs[] = { "e2e4", "e7e5", "e1e2", "e8e7" };
+	NormalChess stack[5];
+	stack[0] = *chess;
+	for (int i = 0; i < 4; i++)
+	{
+		NormalChessMove move;
+		int isOk = NormalChessParseMove(&stack[i], moveStrs[i], &move);
+		assert(isOk);
+		NormalChessMakeMoveCopy(&stack[i], move, &stack[i + 1]);
+		NormalChessDoMove(clone, move);
+		assert(stack[i + 1].key == clone->key);
+		assert(stack[i + 1].key == NormalChessComputeKey(&stack[i + 1]));
+		assert(!memcmp(&stack[i + 1].board, &clone->board, sizeof(clone->board)));
+		(void)isOk;
+	}
+	assert(stack[4].castleFlags == (CF_WHITE_KING_MOVED | CF_BLACK_KING_MOVED));
+	// The original is unchanged.
+	assert(chess->turn == 0);
+	assert(chess->castleFlags == 0);
+	assert(!memcmp(&chess->board, &stack[0].board, sizeof(chess->board)));
+	NormalChessDestroy(clone);
+	NormalChessDestroy(chess);
+}
+
+// Find the legal move of a piece to a target square (for moves which the player makes).
+// A pawn moving to the last row is NOT promoted by the move, because the player chooses what to
+// promote the pawn to afterwards (see NormalChessGetPawnPromotion).
+// Returns: the move, or NORMAL_CHESS_NO_MOVE if there is no such legal move.
+NormalChessMove NormalChessCreateMove(NormalChess *chess, int startCol, int startRow, int targetCol,
+		int targetRow)
+{
+	assert(chess);
+	int subject = startRow * 8 + startCol;
+	int target = targetRow * 8 + targetCol;
+	NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+	int count = NormalChessGenerateLegalMoves(chess, moves);
+	for (int i = 0; i < count; i++)
+	{
+		NormalChessMove m = moves[i];
+		if (NormalChessMoveSubject(m) == subject && NormalChessMoveTarget(m) == target)
+		{
+			if (NormalChessMoveFlags(m) & MF_PROMOTE)
+			{
+				// Keep whether it is a capture, but not the promotion.
+				return NormalChessMoveFromSquares(subject, target, NormalChessMoveFlags(m) & MF_CAPTURE);
+			}
+			return m;
+		}
+	}
+	return NORMAL_CHESS_NO_MOVE;
+}
+
+// The castling flag for the starting square of a king or rook (0 for any other square).
+int NormalChessSquareCastleFlags(int square)
+{
+	switch (square)
+	{
+		case 0 * 8 + 4: return CF_WHITE_KING_MOVED;
+		case 0 * 8 + 7: return CF_WHITE_KINGS_ROOK_MOVED;
+		case 0 * 8 + 0: return CF_WHITE_QUEENS_ROOK_MOVED;
+		case 7 * 8 + 4: return CF_BLACK_KING_MOVED;
+		case 7 * 8 + 7: return CF_BLACK_KINGS_ROOK_MOVED;
+		case 7 * 8 + 0: return CF_BLACK_QUEENS_ROOK_MOVED;
+		default: return 0;
+	}
+}
+
+// Update any flags that result from moving the king or rooks (for castling).
+// A move from or to a king's or rook's starting square means that the piece there has moved (or
+// has been captured), so castling is no longer possible with it.
+void NormalChessUpdateMovementFlags(NormalChess *chess, NormalChessMove move)
+{
+	assert(chess);
+	chess->castleFlags |= NormalChessSquareCastleFlags(NormalChessMoveSubject(move))
+		| NormalChessSquareCastleFlags(NormalChessMoveTarget(move));
+}
+
+// Column that the rook moves to for a castling move (the other side of the king).
+int NormalChessCastleRookTargetCol(NormalChessMove move)
+{
+	int targetCol = NormalChessMoveTarget(move) % 8;
+	return (NormalChessMoveFlags(move) == MF_KING_CASTLE)? targetCol - 1 : targetCol + 1;
+}
+
+// Do a move and go on to the next turn, saving what is needed to take the move back again in the
+// undo record. Does not allocate or free anything: the captured piece (if any) stays in the pool
+// and its index is kept in the undo record.
+void NormalChessMakeMove(NormalChess *chess, NormalChessMove move, NormalChessUndo *undo)
+{
+	assert(chess);
+	assert(undo);
+	int subjectRow = NormalChessMoveSubject(move) / 8;
+	int subjectCol = NormalChessMoveSubject(move) % 8;
+	int targetRow = NormalChessMoveTarget(move) / 8;
+	int targetCol = NormalChessMoveTarget(move) % 8;
+	NormalChessPiece *subject = PiecesGetAt(chess, subjectRow, subjectCol);
+	assert(subject);
+	undo->captured = -1;
+	undo->castleFlags = chess->castleFlags;
+	undo->doublePawnCol = chess->doublePawnCol;
+	undo->halfMoveClock = chess->halfMoveClock;
+	undo->attacks[0] = chess->bbAttacks[0];
+	undo->attacks[1] = chess->bbAttacks[1];
+	undo->key = chess->key;
+	// The castling flags, en passant column, and turn all change, so take them out of the key and
+	// then put them back in at the end.
+	chess->key ^= NormalChessKeyState(chess);
+	int object = NormalChessMoveObjectSquare(move);
+	// The half move clock starts again after a capture or a pawn move.
+	int isPawn = (subject->kind == WHITE_PAWN || subject->kind == BLACK_PAWN);
+	if (NormalChessMoveIsCapture(move) || isPawn)
+	{
+		chess->halfMoveClock = 0;
+	}
+	else if (chess->halfMoveClock < 255)
+	{
+		chess->halfMoveClock++;
+	}
+	if (NormalChessMoveIsCastle(move))
+	{
+		// Castling -> the rook moves to the other side of the king.
+		PiecesDoMove(chess, object / 8, object % 8, object / 8, NormalChessCastleRookTargetCol(move));
+	}
+	else if (object >= 0)
+	{
+		// Capture (for en passant, the object is not on the target square).
+		NormalChessPiece *captured = PiecesTakePieceAt(chess, object / 8, object % 8);
+		assert(captured);
+		undo->captured = captured - chess->pieces;
+	}
+	NormalChessUpdateMovementFlags(chess, move);
+	// En passant is only allowed right after the double pawn move.
+	chess->doublePawnCol = (NormalChessMoveFlags(move) == MF_DOUBLE_PAWN)? subjectCol : -1;
+	// The subject always moves/captures to the target spot.
+	PiecesDoMove(chess, subjectRow, subjectCol, targetRow, targetCol);
+	int promoteKind = NormalChessMovePromoteKind(move, subject->kind);
+	if (promoteKind >= 0)
+	{
+		NormalChessPromotePiece(chess, subject, promoteKind);
+	}
+	NormalChessUpdateAttacks(chess);
+	chess->turn++;
+	chess->key ^= NormalChessKeyState(chess);
+}
+
+// Take back a move done with NormalChessMakeMove, which must be the most recent move made.
+void NormalChessUnmakeMove(NormalChess *chess, NormalChessMove move, const NormalChessUndo *undo)
+{
+	assert(chess);
+	assert(undo);
+	chess->turn--;
+	int subjectRow = NormalChessMoveSubject(move) / 8;
+	int subjectCol = NormalChessMoveSubject(move) % 8;
+	int targetRow = NormalChessMoveTarget(move) / 8;
+	int targetCol = NormalChessMoveTarget(move) % 8;
+	NormalChessPiece *subject = PiecesGetAt(chess, targetRow, targetCol);
+	assert(subject);
+	if (NormalChessMoveFlags(move) & MF_PROMOTE)
+	{
+		NormalChessPromotePiece(chess, subject, NormalChessKindForTeam(WHITE_PAWN, subject->kind));
+	}
+	PiecesDoMove(chess, targetRow, targetCol, subjectRow, subjectCol);
+	if (NormalChessMoveIsCastle(move))
+	{
+		int rook = NormalChessMoveObjectSquare(move);
+		PiecesDoMove(chess, rook / 8, NormalChessCastleRookTargetCol(move), rook / 8, rook % 8);
+	}
+	else if (undo->captured >= 0)
+	{
+		PiecesPutPiece(chess, &chess->pieces[undo->captured]);
+	}
+	chess->castleFlags = undo->castleFlags;
+	chess->doublePawnCol = undo->doublePawnCol;
+	chess->halfMoveClock = undo->halfMoveClock;
+	chess->bbAttacks[0] = undo->attacks[0];
+	chess->bbAttacks[1] = undo->attacks[1];
+	chess->key = undo->key;
+}
+
+// Do a move for the game and go on to the next turn.
+void NormalChessDoMove(NormalChess *chess, NormalChessMove move)
+{
+	assert(chess);
+	assert(move != NORMAL_CHESS_NO_MOVE);
+	NormalChessUndo undo;
+	NormalChessMakeMove(chess, move, &undo);
+}
+
+// Copy-make: put the position after a move into out, leaving the original position as it is.
+// This is an alternative to NormalChessMakeMove and NormalChessUnmakeMove for when the positions
+// are kept around (such as in a search stack), because there is nothing to take back.
+void NormalChessMakeMoveCopy(const NormalChess *chess, NormalChessMove move, NormalChess *out)
+{
+	assert(chess);
+	assert(out);
+	assert(out != chess);
+	NormalChessUndo undo;
+	*out = *chess;
+	NormalChessMakeMove(out, move, &undo);
+}
+
+// See if a piece is prevented from moving to a target square because the move would leave its own
+// king in check. The move is tried out on a copy of the board, so a capture which gets rid of the
+// attacking piece (including en passant) is allowed.
+int PiecesIsPiecePinned(const NormalChessBoard *board, const NormalChessPiece *p, int targetRow,
+		int targetCol)
+{
+	assert(board);
+	assert(p);
+	NormalChessBoard after = *board;
+	if (NormalChessBoardKindAt(&after, targetRow, targetCol) >= 0)
+	{
+		// Normal capture.
+		NormalChessBoardRemove(&after, targetRow, targetCol);
+	}
+	else if ((p->kind == WHITE_PAWN || p->kind == BLACK_PAWN) && targetCol != p->col)
+	{
+		// En passant -> the captured pawn is next to the moving pawn.
+		NormalChessBoardRemove(&after, p->row, targetCol);
+	}
+	NormalChessBoardRemove(&after, p->row, p->col);
+	NormalChessBoardPut(&after, p->kind, targetRow, targetCol);
+	int kingRow, kingCol;
+	if (!NormalChessBoardFindKing(&after, p->kind, &kingRow, &kingCol))
+	{
+		// No king means that the pieces cannot move.
+		return 1;
+	}
+	// Check if any of the enemy pieces may capture the king.
+	return PiecesCanTeamCaptureSpot(&after, NormalChessEnemyKingKind(p->kind), kingRow, kingCol);
+}
+
+// Pack a move (see NormalChessMove). Squares are row * 8 + col.
+NormalChessMove NormalChessMoveFromSquares(int subject, int target, int flags)
+{
+	assert(subject >= 0 && subject < 64);
+	assert(target >= 0 && target < 64);
+	return (NormalChessMove)(subject | (target << 6) | (flags << 12));
+}
+
+// Square that the moving piece starts on.
+int NormalChessMoveSubject(NormalChessMove move)
+{
+	return move & 0x3F;
+}
+
+// Square that the moving piece moves to.
+int NormalChessMoveTarget(NormalChessMove move)
+{
+	return (move >> 6) & 0x3F;
+}
+
+// Get the NormalChessMoveFlag's of the move.
+int NormalChessMoveFlags(NormalChessMove move)
+{
+	return move >> 12;
+}
+
+int NormalChessMoveIsCapture(NormalChessMove move)
+{
+	return (NormalChessMoveFlags(move) & MF_CAPTURE) != 0;
+}
+
+int NormalChessMoveIsCastle(NormalChessMove move)
+{
+	int flags = NormalChessMoveFlags(move);
+	return flags == MF_KING_CASTLE || flags == MF_QUEEN_CASTLE;
+}
+
+// Get what a pawn is promoted to by the move.
+// Returns: the NormalChessKind (on the given team), or -1 if the move is not a promotion.
+int NormalChessMovePromoteKind(NormalChessMove move, NormalChessKind team)
+{
+	static const NormalChessKind promoteKinds[4] =
+	{
+		WHITE_KNIGHT, WHITE_BISHOP, WHITE_ROOK, WHITE_QUEEN
+	};
+	int flags = NormalChessMoveFlags(move);
+	if (!(flags & MF_PROMOTE))
+	{
+		return -1;
+	}
+	return NormalChessKindForTeam(promoteKinds[flags & 3], team);
+}
+
+// Get the square of the object piece, which is the piece captured or the rook for castling.
+// Returns: the square, or -1 if there is no object piece.
+int NormalChessMoveObjectSquare(NormalChessMove move)
+{
+	int subject = NormalChessMoveSubject(move);
+	int target = NormalChessMoveTarget(move);
+	switch (NormalChessMoveFlags(move))
+	{
+		case MF_EN_PASSANT:
+			// The captured pawn is next to the capturing pawn.
+			return (subject / 8) * 8 + target % 8;
+		case MF_KING_CASTLE:
+			return (subject / 8) * 8 + 7;
+		case MF_QUEEN_CASTLE:
+			return (subject / 8) * 8 + 0;
+		default:
+			return NormalChessMoveIsCapture(move)? target : -1;
+	}
+}
+
+// Add the moves of a pawn from one square to another, which are either a single move or one move
+// for each kind of piece to promote to (if the pawn reaches the last row).
+// Returns: the new number of moves in the out array.
+int NormalChessAddPawnMoves(NormalChessMove *out, int count, int subject, int target,
+		int isCapture)
+{
+	int row = target / 8;
+	int flags = isCapture? MF_CAPTURE : MF_QUIET;
+	if (row != 0 && row != 7)
+	{
+		out[count++] = NormalChessMoveFromSquares(subject, target, flags);
+		return count;
+	}
+	// Queen first, because it is almost always the best choice.
+	out[count++] = NormalChessMoveFromSquares(subject, target, flags | MF_PROMOTE_QUEEN);
+	out[count++] = NormalChessMoveFromSquares(subject, target, flags | MF_PROMOTE_ROOK);
+	out[count++] = NormalChessMoveFromSquares(subject, target, flags | MF_PROMOTE_BISHOP);
+	out[count++] = NormalChessMoveFromSquares(subject, target, flags | MF_PROMOTE_KNIGHT);
+	return count;
+}
+
+// Generate the pseudo-legal moves for the current team. These follow each piece's movement
+// pattern (including special moves), but they might leave the team's own king in check (see
+// NormalChessMoveIsLegal).
+// Does not allocate. The out array must have room for NORMAL_CHESS_MAX_MOVES.
+// Returns: the number of moves written to the out array.
+int NormalChessGenerateMoves(const NormalChess *chess, NormalChessMove out[NORMAL_CHESS_MAX_MOVES])
+{
+	return NormalChessGenerateMoveSet(chess, MS_ALL, ~((Bitboard)0), out);
+}
+
+// Generate some of the pseudo-legal moves for the current team (see NormalChessGenerateMoves):
+// only the moves in the set, and only the moves of the pieces on the subject squares.
+// Does not allocate. The out array must have room for the moves (NORMAL_CHESS_MAX_MOVES is always
+// enough).
+// Returns: the number of moves written to the out array.
+int NormalChessGenerateMoveSet(const NormalChess *chess, NormalChessMoveSet set, Bitboard subjects,
+		NormalChessMove *out)
+{
+	assert(chess);
+	assert(out);
+	const NormalChessBoard *board = &chess->board;
+	NormalChessKind team = NormalChessCurrentKing(chess);
+	int teamIndex = NormalChessTeamIndex(team);
+	Bitboard own = board->bbTeams[teamIndex];
+	Bitboard enemy = board->bbTeams[1 - teamIndex];
+	Bitboard occupied = own | enemy;
+	int isNoisy = (set & MS_NOISY) != 0;
+	int isQuiet = (set & MS_QUIET) != 0;
+	// Squares that the pieces other than pawns can move to, for the set.
+	Bitboard allowed = (isNoisy? enemy : 0) | (isQuiet? ~occupied : 0);
+	int count = 0;
+	// Pieces other than pawns move to the squares that they attack, if the square does not have
+	// a piece on the same team.
+	for (NormalChessKind k = team; k < team + (WHITE_PAWN - WHITE_KING); k++)
+	{
+		Bitboard pieces = board->bbPieces[k] & subjects;
+		while (pieces)
+		{
+			int subject = BitboardFirstSquare(pieces);
+			pieces &= pieces - 1;
+			Bitboard targets = NormalChessBoardAttacks(board, k, subject / 8, subject % 8)
+				& ~own & allowed;
+			while (targets)
+			{
+				int target = BitboardFirstSquare(targets);
+				targets &= targets - 1;
+				int flags = (enemy & BitboardAt(target / 8, target % 8))? MF_CAPTURE : MF_QUIET;
+				out[count++] = NormalChessMoveFromSquares(subject, target, flags);
+			}
+		}
+	}
+	// Pawns move forwards (maybe twice on their first move) and capture diagonally. Moving to the
+	// last row is a promotion, which is a noisy move.
+	NormalChessKind pawn = NormalChessKindForTeam(WHITE_PAWN, team);
+	int forward = (team == WHITE_KING)? 8 : -8;
+	int startRow = (team == WHITE_KING)? 1 : 6;
+	int lastRow = (team == WHITE_KING)? 6 : 1;
+	int enPassantRow = (team == WHITE_KING)? 4 : 3;
+	Bitboard pawns = board->bbPieces[pawn] & subjects;
+	while (pawns)
+	{
+		int subject = BitboardFirstSquare(pawns);
+		pawns &= pawns - 1;
+		int row = subject / 8;
+		int col = subject % 8;
+		int target = subject + forward;
+		int isPushAllowed = (row == lastRow)? isNoisy : isQuiet;
+		if (isPushAllowed && !(occupied & BitboardAt(target / 8, target % 8)))
+		{
+			count = NormalChessAddPawnMoves(out, count, subject, target, 0);
+			int target2 = target + forward;
+			if (row == startRow && !(occupied & BitboardAt(target2 / 8, target2 % 8)))
+			{
+				out[count++] = NormalChessMoveFromSquares(subject, target2, MF_DOUBLE_PAWN);
+			}
+		}
+		if (!isNoisy)
+		{
+			continue;
+		}
+		Bitboard captures = BitboardPawnAttacks(BitboardAt(row, col), pawn) & enemy;
+		while (captures)
+		{
+			target = BitboardFirstSquare(captures);
+			captures &= captures - 1;
+			count = NormalChessAddPawnMoves(out, count, subject, target, 1);
+		}
+		if (row == enPassantRow && chess->doublePawnCol >= 0 && abs(col - chess->doublePawnCol) == 1
+				&& NormalChessBoardKindAt(board, row, chess->doublePawnCol)
+					== (int)NormalChessKindForTeam(WHITE_PAWN, NormalChessEnemyKingKind(team)))
+		{
+			int object = row * 8 + chess->doublePawnCol;
+			out[count++] = NormalChessMoveFromSquares(subject, object + forward, MF_EN_PASSANT);
+		}
+	}
+	// Castling moves the king two squares.
+	int kingRow, kingCol;
+	if (isQuiet && (board->bbPieces[team] & subjects)
+			&& NormalChessBoardFindKing(board, team, &kingRow, &kingCol))
+	{
+		NormalChessPiece king = (NormalChessPiece){ .kind = team, .row = kingRow, .col = kingCol };
+		int subject = kingRow * 8 + kingCol;
+		if (NormalChessCanCastle(chess, &king, 1))
+		{
+			out[count++] = NormalChessMoveFromSquares(subject, subject + 2, MF_KING_CASTLE);
+		}
+		if (NormalChessCanCastle(chess, &king, 0))
+		{
+			out[count++] = NormalChessMoveFromSquares(subject, subject - 2, MF_QUEEN_CASTLE);
+		}
+	}
+	assert(count <= NORMAL_CHESS_MAX_MOVES);
+	return count;
+}
+
+// Check whether a move from somewhere else (like a saved search result) is one that
+// NormalChessGenerateMoves would give for the position, by generating the moves of its subject.
+int NormalChessMoveIsPseudoLegal(const NormalChess *chess, NormalChessMove move)
+{
+	assert(chess);
+	NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+	int subject = NormalChessMoveSubject(move);
+	int count = NormalChessGenerateMoveSet(chess, MS_ALL, ((Bitboard)1) << subject, moves);
+	for (int i = 0; i < count; i++)
+	{
+		if (moves[i] == move)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Check that a move from NormalChessGenerateMoves does not leave the team's own king in check.
+int NormalChessMoveIsLegal(const NormalChess *chess, NormalChessMove move)
+{
+	assert(chess);
+	int square = NormalChessMoveSubject(move);
+	int target = NormalChessMoveTarget(move);
+	NormalChessPiece subject = (NormalChessPiece)
+	{
+		.kind = NormalChessBoardKindAt(&chess->board, square / 8, square % 8),
+		.row = square / 8,
+		.col = square % 8,
+	};
+	assert(subject.kind >= 0);
+	return !PiecesIsPiecePinned(&chess->board, &subject, target / 8, target % 8);
+}
+
+// Work out the checks and pins on the current team's king.
+void NormalChessGetCheckInfo(const NormalChess *chess, NormalChessCheckInfo *info)
+{
+	assert(chess);
+	assert(info);
+	const NormalChessBoard *board = &chess->board;
+	NormalChessKind team = NormalChessCurrentKing(chess);
+	NormalChessKind enemy = NormalChessEnemyKingKind(team);
+	Bitboard own = board->bbTeams[NormalChessTeamIndex(team)];
+	Bitboard enemies = board->bbTeams[NormalChessTeamIndex(enemy)];
+	info->checkers = 0;
+	info->checkMask = ~((Bitboard)0);
+	info->pinned = 0;
+	if (!board->bbPieces[team])
+	{
+		// No king to protect.
+		info->kingSquare = -1;
+		return;
+	}
+	int king = BitboardFirstSquare(board->bbPieces[team]);
+	info->kingSquare = king;
+	if (NormalChessIsSquareAttacked(chess, enemy, king / 8, king % 8))
+	{
+		info->checkers = NormalChessBoardAttackersOf(board, enemy, king, own | enemies);
+	}
+	int checkCount = BitboardPopCount(info->checkers);
+	if (checkCount == 1)
+	{
+		// Capture the checking piece or block it (if it is a sliding piece).
+		int checker = BitboardFirstSquare(info->checkers);
+		info->checkMask = info->checkers | BitboardBetween(king, checker);
+	}
+	else if (checkCount > 1)
+	{
+		// Double check -> only the king can move.
+		info->checkMask = 0;
+	}
+	// A piece is pinned if it is the only piece between the king and an enemy sliding piece which
+	// would otherwise attack the king.
+	Bitboard queens = board->bbPieces[NormalChessKindForTeam(WHITE_QUEEN, enemy)];
+	Bitboard rooks = board->bbPieces[NormalChessKindForTeam(WHITE_ROOK, enemy)] | queens;
+	Bitboard bishops = board->bbPieces[NormalChessKindForTeam(WHITE_BISHOP, enemy)] | queens;
+	Bitboard pinners = (BitboardRookAttacks(king, enemies) & rooks)
+		| (BitboardBishopAttacks(king, enemies) & bishops);
+	while (pinners)
+	{
+		int pinner = BitboardFirstSquare(pinners);
+		pinners &= pinners - 1;
+		Bitboard between = BitboardBetween(king, pinner) & (own | enemies);
+		if (BitboardPopCount(between) == 1 && (between & own))
+		{
+			info->pinned |= between;
+		}
+	}
+}
+
+// Check whether a move from NormalChessGenerateMoves is legal, using the check info for the
+// position (which is much faster than NormalChessMoveIsLegal).
+int NormalChessMoveIsLegalWith(const NormalChess *chess, const NormalChessCheckInfo *info,
+		NormalChessMove move)
+{
+	int subject = NormalChessMoveSubject(move);
+	int target = NormalChessMoveTarget(move);
+	Bitboard targetBit = ((Bitboard)1) << target;
+	if (info->kingSquare < 0)
+	{
+		return 1;
+	}
+	if (subject == info->kingSquare)
+	{
+		if (NormalChessMoveIsCastle(move))
+		{
+			// The castling rules already make sure that the king is not in check on the way.
+			return 1;
+		}
+		// The king cannot move to an attacked square (the attack maps already look through the
+		// king, so it cannot back away along the line of a sliding piece either).
+		NormalChessKind enemy = NormalChessEnemyKingKind(NormalChessCurrentKing(chess));
+		return !NormalChessIsSquareAttacked(chess, enemy, target / 8, target % 8);
+	}
+	if (NormalChessMoveFlags(move) == MF_EN_PASSANT)
+	{
+		// En passant takes two pieces off of the capturing pawn's row at once, which might uncover
+		// an attack on the king, so try it out on a copy of the board (it is a rare move anyway).
+		return NormalChessMoveIsLegal(chess, move);
+	}
+	if (!(info->checkMask & targetBit))
+	{
+		return 0;
+	}
+	// A pinned piece can only move along the line between the king and the pinning piece.
+	if ((info->pinned & (((Bitboard)1) << subject))
+			&& !(BitboardLine(info->kingSquare, subject) & targetBit))
+	{
+		return 0;
+	}
+	return 1;
+}
+
+// Generate only the legal moves for the current team (see NormalChessGenerateMoves).
+// Returns: the number of moves written to the out array.
+int NormalChessGenerateLegalMoves(const NormalChess *chess,
+		NormalChessMove out[NORMAL_CHESS_MAX_MOVES])
+{
+	NormalChessCheckInfo info;
+	NormalChessGetCheckInfo(chess, &info);
+	int count = NormalChessGenerateMoves(chess, out);
+	int legalCount = 0;
+	for (int i = 0; i < count; i++)
+	{
+		if (NormalChessMoveIsLegalWith(chess, &info, out[i]))
+		{
+			out[legalCount++] = out[i];
+		}
+	}
+	return legalCount;
+}
+
+int NormalChessIsKingInCheck(NormalChess *chess)
+{
+	NormalChessKind currentKing = NormalChessCurrentKing(chess);
+	int kingRow, kingCol;
+	if (!NormalChessBoardFindKing(&chess->board, currentKing, &kingRow, &kingCol))
+	{
+		return 0;
+	}
+	return NormalChessIsSquareAttacked(chess, NormalChessEnemyKingKind(currentKing), kingRow,
+			kingCol);
+}
+
+int NormalChessCanMove(NormalChess *chess)
+{
+	assert(chess);
+	// Check if any pieces on the current team can move.
+	NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+	return NormalChessGenerateLegalMoves(chess, moves) > 0;
+}
+
+int NormalChessIsStalemate(NormalChess *chess)
+{
+	return !NormalChessIsKingInCheck(chess) && !NormalChessCanMove(chess);
+}
+
+int NormalChessIsCheckmate(NormalChess *chess)
+{
+	return NormalChessIsKingInCheck(chess) && !NormalChessCanMove(chess);
+}
+
+int NormalChessIsGameOver(NormalChess *chess)
+{
+	return !NormalChessCanMove(chess)
+		|| !chess->board.bbPieces[WHITE_KING]
+		|| !chess->board.bbPieces[BLACK_KING];
+}
+
+// Write a move in coordinate notation, like "e2e4", or "e7e8q" for a promotion.
+// The out string must have room for 6 chars (including the null terminator).
+void NormalChessMoveToString(NormalChessMove move, char out[6])
+{
+	int i = 0;
+	int subject = NormalChessMoveSubject(move);
+	int target = NormalChessMoveTarget(move);
+	out[i++] = 'a' + subject % 8;
+	out[i++] = '1' + subject / 8;
+	out[i++] = 'a' + target % 8;
+	out[i++] = '1' + target / 8;
+	if (NormalChessMoveFlags(move) & MF_PROMOTE)
+	{
+		out[i++] = "nbrq"[NormalChessMoveFlags(move) & 3];
+	}
+	out[i] = '\0';
+}
+
+// Find the legal move for the current team which is written in coordinate notation (see
+// NormalChessMoveToString).
+// Returns: 1 if the move was found and written to the move parameter, otherwise 0.
+int NormalChessParseMove(const NormalChess *chess, const char *str, NormalChessMove *move)
+{
+	assert(chess);
+	assert(str);
+	assert(move);
+	NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+	int count = NormalChessGenerateLegalMoves(chess, moves);
+	for (int i = 0; i < count; i++)
+	{
+		char moveStr[6];
+		NormalChessMoveToString(moves[i], moveStr);
+		if (!strcmp(moveStr, str))
+		{
+			*move = moves[i];
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// The character for each NormalChessKind in FEN.
+static const char fenPieceChars[] = "KQRBNPkqrbnp";
+
+// Set up a position from Forsyth-Edwards Notation (FEN), such as NORMAL_CHESS_START_FEN. The half
+// move clock and full move number at the end may be left out. Nothing is allocated.
+// Returns: 1 if successful, or 0 if the FEN is not valid (and then the position is not changed).
+int NormalChessSetUpFEN(NormalChess *chess, const char *fen)
+{
+	assert(chess);
+	assert(fen);
+	// Parse into a copy, so that a bad FEN does not leave behind half of a position.
+	NormalChess parsed;
+	NormalChessClear(&parsed);
+	const char *s = fen;
+	// Piece placement, from the top row down.
+	int row = 7;
+	int col = 0;
+	for (; *s && *s != ' '; s++)
+	{
+		const char *pieceChar = strchr(fenPieceChars, *s);
+		if (*s == '/')
+		{
+			if (col != 8 || row == 0)
+			{
+				return 0;
+			}
+			row--;
+			col = 0;
+		}
+		else if ('1' <= *s && *s <= '8' && col + (*s - '0') <= 8)
+		{
+			col += *s - '0';
+		}
+		else if (pieceChar && col < 8 && parsed.pieceCount < NORMAL_CHESS_MAX_PIECES)
+		{
+			NormalChessKind kind = pieceChar - fenPieceChars;
+			if (kind % 6 == WHITE_PAWN && (row == 0 || row == 7))
+			{
+				// Pawns can never be on the first or last row (they promote there).
+				return 0;
+			}
+			NormalChessAddPiece(&parsed, kind, row, col);
+			col++;
+		}
+		else
+		{
+			return 0;
+		}
+	}
+	if (row != 0 || col != 8 || *s++ != ' ')
+	{
+		return 0;
+	}
+	// Side to move.
+	if ((*s != 'w' && *s != 'b') || s[1] != ' ')
+	{
+		return 0;
+	}
+	parsed.turn = (*s == 'b');
+	s += 2;
+	// Castling rights: a missing right means that the rook has moved.
+	parsed.castleFlags = CF_WHITE_KINGS_ROOK_MOVED | CF_WHITE_QUEENS_ROOK_MOVED
+		| CF_BLACK_KINGS_ROOK_MOVED | CF_BLACK_QUEENS_ROOK_MOVED;
+	for (s += (*s == '-'); *s && *s != ' '; s++)
+	{
+		switch (*s)
+		{
+			case 'K': parsed.castleFlags &= ~CF_WHITE_KINGS_ROOK_MOVED; break;
+			case 'Q': parsed.castleFlags &= ~CF_WHITE_QUEENS_ROOK_MOVED; break;
+			case 'k': parsed.castleFlags &= ~CF_BLACK_KINGS_ROOK_MOVED; break;
+			case 'q': parsed.castleFlags &= ~CF_BLACK_QUEENS_ROOK_MOVED; break;
+			default: return 0;
+		}
+	}
+	if (*s++ != ' ')
+	{
+		return 0;
+	}
+	// En passant target square, which is behind the pawn that just moved two squares.
+	if (*s == '-')
+	{
+		s++;
+	}
+	else if ('a' <= s[0] && s[0] <= 'h' && s[1] == (parsed.turn? '3' : '6'))
+	{
+		parsed.doublePawnCol = s[0] - 'a';
+		s += 2;
+	}
+	else
+	{
+		return 0;
+	}
+	// Half move clock and full move number.
+	long halfMoves = 0;
+	long fullMoves = 1;
+	if (*s == ' ')
+	{
+		char *end;
+		halfMoves = strtol(s, &end, 10);
+		if (end == s || halfMoves < 0)
+		{
+			return 0;
+		}
+		s = end;
+		if (*s == ' ')
+		{
+			fullMoves = strtol(s, &end, 10);
+			if (end == s || fullMoves < 0 || fullMoves > 1000000)
+			{
+				return 0;
+			}
+			s = end;
+		}
+	}
+	if (*s != '\0' && *s != '\n' && *s != '\r')
+	{
+		return 0;
+	}
+	parsed.halfMoveClock = (halfMoves < 255)? halfMoves : 255;
+	parsed.turn += (fullMoves > 1)? 2 * (fullMoves - 1) : 0;
+	NormalChessUpdateAll(&parsed);
+	*chess = parsed;
+	return 1;
+}
+
+// Write a position in Forsyth-Edwards Notation (FEN).
+void NormalChessToFEN(const NormalChess *chess, char out[NORMAL_CHESS_MAX_FEN])
+{
+	assert(chess);
+	assert(out);
+	int i = 0;
+	for (int row = 7; row >= 0; row--)
+	{
+		int empty = 0;
+		for (int col = 0; col < 8; col++)
+		{
+			int k = NormalChessBoardKindAt(&chess->board, row, col);
+			if (k < 0)
+			{
+				empty++;
+				continue;
+			}
+			if (empty)
+			{
+				out[i++] = '0' + empty;
+				empty = 0;
+			}
+			out[i++] = fenPieceChars[k];
+		}
+		if (empty)
+		{
+			out[i++] = '0' + empty;
+		}
+		out[i++] = (row > 0)? '/' : ' ';
+	}
+	int isBlack = chess->turn % 2;
+	out[i++] = isBlack? 'b' : 'w';
+	out[i++] = ' ';
+	// Castling is allowed if neither the king nor the rook has moved.
+	static const int castleRights[4] =
+	{
+		CF_WHITE_KING_MOVED | CF_WHITE_KINGS_ROOK_MOVED,
+		CF_WHITE_KING_MOVED | CF_WHITE_QUEENS_ROOK_MOVED,
+		CF_BLACK_KING_MOVED | CF_BLACK_KINGS_ROOK_MOVED,
+		CF_BLACK_KING_MOVED | CF_BLACK_QUEENS_ROOK_MOVED,
+	};
+	int start = i;
+	for (int r = 0; r < 4; r++)
+	{
+		if (!(chess->castleFlags & castleRights[r]))
+		{
+			out[i++] = "KQkq"[r];
+		}
+	}
+	if (i == start)
+	{
+		out[i++] = '-';
+	}
+	out[i++] = ' ';
+	if (chess->doublePawnCol >= 0)
+	{
+		out[i++] = 'a' + chess->doublePawnCol;
+		out[i++] = isBlack? '3' : '6';
+	}
+	else
+	{
+		out[i++] = '-';
+	}
+	snprintf(out + i, NORMAL_CHESS_MAX_FEN - i, " %d %d", chess->halfMoveClock,
+			chess->turn / 2 + 1);
+}
+
+void TestNormalChessFEN(void)
+{
+	char fen[NORMAL_CHESS_MAX_FEN];
+	NormalChess *chess = NormalChessInit();
+	NormalChess parsed;
+	int isOk = NormalChessSetUpFEN(&parsed, NORMAL_CHESS_START_FEN);
+	assert(isOk);
+	assert(parsed.key == chess->key);
+	assert(!memcmp(&parsed.board, &chess->board, sizeof(chess->board)));
+	NormalChessToFEN(chess, fen);
+	assert(!strcmp(fen, NORMAL_CHESS_START_FEN));
+	// The turn, en passant and counters are kept up to date by moves.
+	NormalChessMove move;
+	isOk = NormalChessParseMove(chess, "e2e4", &move);
+	assert(isOk);
+	NormalChessDoMove(chess, move);
+	NormalChessToFEN(chess, fen);
+	assert(!strcmp(fen, "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1"));
+	isOk = NormalChessSetUpFEN(&parsed, fen);
+	assert(isOk);
+	assert(parsed.key == chess->key);
+	isOk = NormalChessParseMove(chess, "g8f6", &move);
+	assert(isOk);
+	NormalChessDoMove(chess, move);
+	isOk = NormalChessParseMove(chess, "e1e2", &move);
+	assert(isOk);
+	NormalChessDoMove(chess, move);
+	NormalChessToFEN(chess, fen);
+	assert(!strcmp(fen, "rnbqkb1r/pppppppp/5n2/8/4P3/8/PPPPKPPP/RNBQ1BNR b kq - 2 2"));
+	// Castling rights and a position which is not from a normal game.
+	const char *kiwipete = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+	isOk = NormalChessSetUpFEN(chess, kiwipete);
+	assert(isOk);
+	NormalChessToFEN(chess, fen);
+	assert(!strcmp(fen, kiwipete));
+	NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+	int count = NormalChessGenerateLegalMoves(chess, moves);
+	assert(count == 48);
+	// Bad FEN is rejected without changing the position.
+	isOk = NormalChessSetUpFEN(chess, "8/8/8 w - - 0 1");
+	assert(!isOk);
+	isOk = NormalChessSetUpFEN(chess, "rnbqkbnr/pppppppp/9/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+	assert(!isOk);
+	isOk = NormalChessSetUpFEN(chess, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x KQkq - 0 1");
+	assert(!isOk);
+	isOk = NormalChessSetUpFEN(chess, "4k2P/8/8/8/8/8/8/4K3 w - - 0 1");
+	assert(!isOk);
+	isOk = NormalChessSetUpFEN(chess, "4k3/8/8/8/8/8/8/p3K3 b - - 0 1");
+	assert(!isOk);
+	isOk = NormalChessSetUpFEN(chess, "4k3/8/8/8/8/8/8/4K3 b - -");
+	assert(isOk);
+	NormalChessToFEN(chess, fen);
+	assert(!strcmp(fen, "4k3/8/8/8/8/8/8/4K3 b - - 0 1"));
+	NormalChessDestroy(chess);
+	(void)isOk;
+	(void)count;
+}
+
+/* vi: set colorcolumn=101 textwidth=100 tabstop=4 noexpandtab: */
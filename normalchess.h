@@ -0,0 +1,271 @@
+#ifndef __NORMAL_CHESS_H
+#define __NORMAL_CHESS_H
+
+// The rules of normal chess, which do not depend on the graphics or the rest of the game.
+
+#include <stdint.h>
+
+typedef enum NormalChessKind
+{
+	WHITE_KING,
+	WHITE_QUEEN,
+	WHITE_ROOK,
+	WHITE_BISHOP,
+	WHITE_KNIGHT,
+	WHITE_PAWN,
+	BLACK_KING,
+	BLACK_QUEEN,
+	BLACK_ROOK,
+	BLACK_BISHOP,
+	BLACK_KNIGHT,
+	BLACK_PAWN,
+} NormalChessKind;
+
+// The fields are small so that the pool of pieces in a NormalChess stays small.
+typedef struct NormalChessPiece
+{
+	int8_t kind; // NormalChessKind
+	int8_t col;  // position column
+	int8_t row;  // position row
+} NormalChessPiece;
+
+// A set of board squares, with one bit per square. The bit for a square is (row * 8 + col), so bit
+// 0 is the bottom-left square (row 0, col 0) and bit 63 is the top-right square (row 7, col 7).
+typedef uint64_t Bitboard;
+
+// Bitboard representation of all of the pieces on the board.
+typedef struct NormalChessBoard
+{
+	Bitboard bbPieces[12]; // the squares occupied by each NormalChessKind
+	Bitboard bbTeams[2];   // the squares occupied by each team (0 = white, 1 = black)
+} NormalChessBoard;
+
+// Lookup table for the squares attacked by a sliding piece (rook or bishop) on one square.
+// Only the pieces on the squares in the mask can block the sliding piece, so the occupied squares
+// in the mask are multiplied by the magic number to gather them into the top (64 - shift) bits,
+// which are then the index into the attacks table.
+typedef struct BitboardMagic
+{
+	Bitboard mask;
+	Bitboard magic;
+	int shift;
+	Bitboard *attacks;
+} BitboardMagic;
+
+// What kind of move a NormalChessMove is.
+typedef enum NormalChessMoveFlag
+{
+	MF_QUIET          = 0,  // normal move to an empty square
+	MF_DOUBLE_PAWN    = 1,  // pawn's first move of two squares
+	MF_KING_CASTLE    = 2,  // castling on the king's side
+	MF_QUEEN_CASTLE   = 3,  // castling on the queen's side
+	MF_CAPTURE        = 4,  // set for every kind of capture
+	MF_EN_PASSANT     = 5,  // (includes MF_CAPTURE)
+	MF_PROMOTE        = 8,  // set for every kind of promotion, which may also be a capture
+	MF_PROMOTE_KNIGHT = 8,
+	MF_PROMOTE_BISHOP = 9,
+	MF_PROMOTE_ROOK   = 10,
+	MF_PROMOTE_QUEEN  = 11,
+} NormalChessMoveFlag;
+
+// Which moves to generate (see NormalChessGenerateMoveSet).
+typedef enum NormalChessMoveSet
+{
+	MS_NOISY = 1,  // captures (including en passant) and promotions
+	MS_QUIET = 2,  // all of the other moves
+	MS_ALL   = 3,
+} NormalChessMoveSet;
+
+// A move packed into 16 bits: the subject square (where the moving piece starts) is bits 0-5, the
+// target square (where it moves to) is bits 6-11, and the NormalChessMoveFlag is bits 12-15.
+// Squares are row * 8 + col. The kind of move is worked out once when the move is generated, so
+// making the move does not need to check the rules again.
+typedef uint16_t NormalChessMove;
+
+// A value which is never a real move (it would move from a1 to a1).
+#define NORMAL_CHESS_NO_MOVE 0
+
+// Size of a move array which can hold all of the moves in any position.
+#define NORMAL_CHESS_MAX_MOVES 256
+
+// Checks and pins on the current team's king, worked out once for a position to quickly check
+// which moves are legal (see NormalChessGetCheckInfo).
+typedef struct NormalChessCheckInfo
+{
+	int kingSquare;     // square of the king (row * 8 + col), or -1 if there is no king
+	Bitboard checkers;  // enemy pieces which attack the king
+	Bitboard checkMask; // squares that a non-king move must go to (to capture or block a checker)
+	Bitboard pinned;    // pieces which are the only thing stopping an attack on their own king
+} NormalChessCheckInfo;
+
+// What NormalChessMakeMove saves to be able to take back (unmake) a move.
+typedef struct NormalChessUndo
+{
+	int captured;              // index in pieces of the captured piece (or -1)
+	int castleFlags;           // NormalChessCastleFlag bits
+	int doublePawnCol;
+	int halfMoveClock;
+	Bitboard attacks[2];       // see NormalChessUpdateAttacks
+	uint64_t key;              // NormalChess key
+} NormalChessUndo;
+
+// Number of pieces that a NormalChess has room for.
+#define NORMAL_CHESS_MAX_PIECES 32
+
+// Bits of NormalChess.castleFlags. A set bit means that the piece has moved (or has been captured),
+// so castling with it is not possible any more.
+typedef enum NormalChessCastleFlag
+{
+	CF_WHITE_KING_MOVED         = 1 << 0,
+	CF_WHITE_KINGS_ROOK_MOVED   = 1 << 1,
+	CF_WHITE_QUEENS_ROOK_MOVED  = 1 << 2,
+	CF_BLACK_KING_MOVED         = 1 << 3,
+	CF_BLACK_KINGS_ROOK_MOVED   = 1 << 4,
+	CF_BLACK_QUEENS_ROOK_MOVED  = 1 << 5,
+} NormalChessCastleFlag;
+
+// The start position in Forsyth-Edwards Notation (see NormalChessSetUpFEN).
+#define NORMAL_CHESS_START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// Size of a string which can hold the FEN for any position (see NormalChessToFEN).
+#define NORMAL_CHESS_MAX_FEN 100
+
+// Normal-chess game data.
+// This has no pointers to anything outside of itself, so a position can be copied with plain
+// assignment (or memcpy) and kept in arrays (see NormalChessClone and NormalChessMakeMoveCopy).
+typedef struct NormalChess
+{
+	int turn;
+	int8_t doublePawnCol; // column of the most recent double pawn move
+	uint8_t castleFlags; // NormalChessCastleFlag bits
+	uint8_t pieceCount; // number of pieces used in the pool
+	uint8_t halfMoveClock; // moves since the last capture or pawn move (stops at 255)
+	NormalChessBoard board; // where the pieces are, this is what the rules are checked against
+	Bitboard bbAttacks[2]; // squares attacked by each team (see NormalChessUpdateAttacks)
+	uint64_t key; // Zobrist key for the position, kept up to date as moves are made
+	int8_t squarePieces[64]; // index in pieces of the piece on each square (or -1)
+	// Pool of all of the pieces in the game, including captured pieces. A piece keeps its place in
+	// the pool for the whole game, so pointers to pieces stay valid (used by sprites). Pointers
+	// into a copy of a position point into the copy, not the original.
+	NormalChessPiece pieces[NORMAL_CHESS_MAX_PIECES];
+} NormalChess;
+
+Bitboard BitboardAt(int row, int col);
+Bitboard BitboardBetween(int a, int b);
+Bitboard BitboardBishopAttacks(int square, Bitboard occupied);
+Bitboard BitboardBishopRays(int square, Bitboard occupied);
+Bitboard BitboardKingAttacks(Bitboard kings);
+Bitboard BitboardKnightAttacks(Bitboard knights);
+Bitboard BitboardLine(int a, int b);
+Bitboard BitboardPawnAttacks(Bitboard pawns, NormalChessKind team);
+Bitboard BitboardRookAttacks(int square, Bitboard occupied);
+Bitboard BitboardRookRays(int square, Bitboard occupied);
+Bitboard BitboardSlideAttacks(int square, Bitboard occupied, int dRow, int dCol);
+Bitboard NormalChessBoardAttackersOf(const NormalChessBoard *board, NormalChessKind team,
+		int square, Bitboard occupied);
+Bitboard NormalChessBoardAttacks(const NormalChessBoard *board, NormalChessKind k, int row,
+		int col);
+Bitboard NormalChessBoardOccupied(const NormalChessBoard *board);
+Bitboard NormalChessBoardTeamAttacks(const NormalChessBoard *board, NormalChessKind team,
+		Bitboard occupied);
+NormalChess *NormalChessAlloc(void);
+NormalChess *NormalChessClone(const NormalChess *chess);
+NormalChess *NormalChessInit(void);
+NormalChessKind NormalChessCurrentKing(const NormalChess *chess);
+NormalChessKind NormalChessEnemyKingKind(NormalChessKind k);
+NormalChessKind NormalChessKindForTeam(NormalChessKind k, NormalChessKind team);
+NormalChessKind NormalChessKingKind(NormalChessKind k);
+NormalChessKind PieceKingOf(const NormalChessPiece *p);
+NormalChessMove NormalChessCreateMove(NormalChess *chess, int startCol, int startRow, int targetCol,
+		int targetRow);
+NormalChessMove NormalChessMoveFromSquares(int subject, int target, int flags);
+NormalChessPiece *NormalChessAddPiece(NormalChess *chess, NormalChessKind k, int row, int col);
+NormalChessPiece *NormalChessGetPawnPromotion(NormalChess *chess);
+NormalChessPiece *NormalChessMoveGetObject(NormalChessMove move, const NormalChess *chess);
+NormalChessPiece *NormalChessMoveGetSubject(NormalChessMove move, const NormalChess *chess);
+NormalChessPiece *PiecesGetAt(const NormalChess *chess, int row, int col);
+NormalChessPiece *PiecesTakePieceAt(NormalChess *chess, int row, int col);
+const char *NormalChessKindToStr(NormalChessKind k);
+int BitboardFirstSquare(Bitboard b);
+int BitboardInitMagic(BitboardMagic *m, int square, int isRook, Bitboard *attacks);
+int BitboardPopCount(Bitboard b);
+int NormalChessAddPawnMoves(NormalChessMove *out, int count, int subject, int target,
+		int isCapture);
+int NormalChessBoardFindKing(const NormalChessBoard *board, NormalChessKind k, int *row, int *col);
+int NormalChessBoardKindAt(const NormalChessBoard *board, int row, int col);
+int NormalChessCanCastle(const NormalChess *chess, const NormalChessPiece *king, int isKingsSide);
+int NormalChessCanMove(NormalChess *chess);
+int NormalChessCanUsePiece(const NormalChess *chess, const NormalChessPiece *p);
+int NormalChessCastleRookTargetCol(NormalChessMove move);
+int NormalChessGenerateLegalMoves(const NormalChess *chess,
+		NormalChessMove out[NORMAL_CHESS_MAX_MOVES]);
+int NormalChessGenerateMoveSet(const NormalChess *chess, NormalChessMoveSet set, Bitboard subjects,
+		NormalChessMove *out);
+int NormalChessGenerateMoves(const NormalChess *chess, NormalChessMove out[NORMAL_CHESS_MAX_MOVES]);
+int NormalChessIsCheckmate(NormalChess *chess);
+int NormalChessIsGameOver(NormalChess *chess);
+int NormalChessIsKingInCheck(NormalChess *chess);
+int NormalChessIsSquareAttacked(const NormalChess *chess, NormalChessKind team, int row, int col);
+int NormalChessIsStalemate(NormalChess *chess);
+int NormalChessMoveFlags(NormalChessMove move);
+int NormalChessMoveIsCapture(NormalChessMove move);
+int NormalChessMoveIsCastle(NormalChessMove move);
+int NormalChessMoveIsLegal(const NormalChess *chess, NormalChessMove move);
+int NormalChessMoveIsLegalWith(const NormalChess *chess, const NormalChessCheckInfo *info,
+		NormalChessMove move);
+int NormalChessMoveIsPseudoLegal(const NormalChess *chess, NormalChessMove move);
+int NormalChessMoveObjectSquare(NormalChessMove move);
+int NormalChessMovePromoteKind(NormalChessMove move, NormalChessKind team);
+int NormalChessMoveSubject(NormalChessMove move);
+int NormalChessMoveTarget(NormalChessMove move);
+int NormalChessMovesContains(const NormalChessPiece *p, int row, int col);
+int NormalChessParseMove(const NormalChess *chess, const char *str, NormalChessMove *move);
+int NormalChessPieceTeamEq(const NormalChessPiece *a, const NormalChessPiece *b);
+int NormalChessSetUpFEN(NormalChess *chess, const char *fen);
+int NormalChessSquareCastleFlags(int square);
+int NormalChessTeamEq(NormalChessKind a, NormalChessKind b);
+int NormalChessTeamIndex(NormalChessKind k);
+int PiecesCanTeamCaptureSpot(const NormalChessBoard *board, NormalChessKind team, int targetRow,
+		int targetCol);
+int PiecesIsOnBoard(const NormalChess *chess, const NormalChessPiece *p);
+int PiecesIsPiecePinned(const NormalChessBoard *board, const NormalChessPiece *p, int targetRow,
+		int targetCol);
+uint64_t NormalChessComputeKey(const NormalChess *chess);
+uint64_t NormalChessKeyPiece(NormalChessKind k, int row, int col);
+uint64_t NormalChessKeyState(const NormalChess *chess);
+uint64_t ZobristRandom(uint64_t *state);
+void BitboardInitLines(void);
+void BitboardInitMagics(void);
+void BitboardInitTables(void);
+void NormalChessBoardClear(NormalChessBoard *board);
+void NormalChessBoardPut(NormalChessBoard *board, NormalChessKind k, int row, int col);
+void NormalChessBoardRemove(NormalChessBoard *board, int row, int col);
+void NormalChessClear(NormalChess *chess);
+void NormalChessDestroy(NormalChess *p);
+void NormalChessDoMove(NormalChess *chess, NormalChessMove move);
+void NormalChessFree(NormalChess *p);
+void NormalChessGetCheckInfo(const NormalChess *chess, NormalChessCheckInfo *info);
+void NormalChessInitZobrist(void);
+void NormalChessMakeMove(NormalChess *chess, NormalChessMove move, NormalChessUndo *undo);
+void NormalChessMakeMoveCopy(const NormalChess *chess, NormalChessMove move, NormalChess *out);
+void NormalChessMoveToString(NormalChessMove move, char out[6]);
+void NormalChessPromotePiece(NormalChess *chess, NormalChessPiece *p, NormalChessKind k);
+void NormalChessSetUp(NormalChess *chess);
+void NormalChessToFEN(const NormalChess *chess, char out[NORMAL_CHESS_MAX_FEN]);
+void NormalChessUnmakeMove(NormalChess *chess, NormalChessMove move, const NormalChessUndo *undo);
+void NormalChessUpdateAll(NormalChess *chess);
+void NormalChessUpdateAttacks(NormalChess *chess);
+void NormalChessUpdateMovementFlags(NormalChess *chess, NormalChessMove move);
+void PiecesDoCapture(NormalChess *chess, int startRow, int startCol, int targetRow, int targetCol);
+void PiecesDoMove(NormalChess *chess, int startRow, int startCol, int targetRow, int targetCol);
+void PiecesPutPiece(NormalChess *chess, NormalChessPiece *p);
+void PiecesRemovePieceAt(NormalChess *chess, int row, int col);
+void TestNormalChessBoard(void);
+void TestNormalChessCheckInfo(void);
+void TestNormalChessClone(void);
+void TestNormalChessFEN(void);
+void TestNormalChessGenerateMoves(void);
+void TestNormalChessMakeMove(void);
+void TestNormalChessMovesContains(void);
+
+#endif /* __NORMAL_CHESS_H */
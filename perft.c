@@ -0,0 +1,298 @@
+// Perft: count all of the positions reached by legal moves down to a depth, to check the move
+// generator against known node counts and to measure how fast it is.
+// Usage: perft DEPTH [-d] [-f FEN] [-t THREADS] [-H MEGABYTES] [MOVE...]
+//  -d    "divide": also print the node count below each first move
+//  -f    start from the position in Forsyth-Edwards Notation instead of the start position
+//  -t    split the work between this many threads
+//  -H    size of the hash table for sharing counts of positions which were already seen
+//  MOVE  moves to play from the start position (or FEN) first, in coordinate notation (like e2e4)
+
+#define _POSIX_C_SOURCE 200112L
+#define STB_DS_IMPLEMENTATION
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "stb_ds.h"
+#include "normalchess.h"
+
+// One slot of the hash table. The slots are shared by all of the threads without any locks, so
+// the check value is the key XOR'd with the data: if another thread wrote half of the slot at the
+// same time, the key will not match and the slot is just treated as empty.
+typedef struct PerftHashEntry
+{
+	uint64_t check; // position key ^ data
+	uint64_t data;  // node count << 8 | depth
+} PerftHashEntry;
+
+// Part of the work for the threads: count the nodes below the position after some moves.
+typedef struct PerftJob
+{
+	int root;                  // index of the first move in rootMoves
+	int moveCount;
+	NormalChessMove moves[2];  // the first move, and maybe a reply to it
+} PerftJob;
+
+// What the perft threads share.
+typedef struct PerftShared
+{
+	int depth;
+	const char *fen;    // position to start from (NULL for the start position)
+	int moveCount;
+	char **moveStrs;    // moves to get to the position to count
+	NormalChessMove rootMoves[NORMAL_CHESS_MAX_MOVES];
+	long long rootNodes[NORMAL_CHESS_MAX_MOVES]; // count for each of rootMoves (atomic)
+	int rootCount;
+	PerftJob *arrJobs;  // dynamic array
+	int nextJob;        // index of the next job for a thread to take (atomic)
+	PerftHashEntry *hashTable; // NULL if not using a hash table
+	uint64_t hashMask;  // number of hash table slots - 1
+} PerftShared;
+
+// Look up the count for a position in the hash table.
+// Returns: the number of nodes, or -1 if the position is not in the table.
+long long PerftHashProbe(const PerftShared *shared, uint64_t key, int depth)
+{
+	PerftHashEntry *entry = &shared->hashTable[key & shared->hashMask];
+	uint64_t check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+	uint64_t data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+	if ((check ^ data) != key || (int)(data & 0xFF) != depth)
+	{
+		return -1;
+	}
+	return (long long)(data >> 8);
+}
+
+// Save the count for a position in the hash table (always replacing what is there).
+void PerftHashStore(PerftShared *shared, uint64_t key, int depth, long long nodes)
+{
+	PerftHashEntry *entry = &shared->hashTable[key & shared->hashMask];
+	uint64_t data = ((uint64_t)nodes << 8) | (uint64_t)depth;
+	__atomic_store_n(&entry->check, key ^ data, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+}
+
+// Count the leaf nodes of the move tree below the current position.
+long long Perft(PerftShared *shared, NormalChess *chess, int depth)
+{
+	NormalChessMove moves[NORMAL_CHESS_MAX_MOVES];
+	if (depth == 0)
+	{
+		return 1;
+	}
+	int useHash = shared->hashTable && depth >= 2;
+	if (useHash)
+	{
+		long long nodes = PerftHashProbe(shared, chess->key, depth);
+		if (nodes >= 0)
+		{
+			return nodes;
+		}
+	}
+	int count = NormalChessGenerateLegalMoves(chess, moves);
+	if (depth == 1)
+	{
+		// Bulk counting: the moves at the last level do not need to be made.
+		return count;
+	}
+	long long nodes = 0;
+	for (int i = 0; i < count; i++)
+	{
+		NormalChessUndo undo;
+		NormalChessMakeMove(chess, moves[i], &undo);
+		nodes += Perft(shared, chess, depth - 1);
+		NormalChessUnmakeMove(chess, moves[i], &undo);
+	}
+	if (useHash)
+	{
+		PerftHashStore(shared, chess->key, depth, nodes);
+	}
+	return nodes;
+}
+
+// Set up the position to count from, by playing the moves from the start position (or the FEN).
+// Returns: 1 if successful, or 0 if the FEN is not valid or one of the moves is illegal.
+int PerftSetup(const PerftShared *shared, NormalChess *chess)
+{
+	if (!shared->fen)
+	{
+		NormalChessSetUp(chess);
+	}
+	else if (!NormalChessSetUpFEN(chess, shared->fen))
+	{
+		fprintf(stderr, "perft: invalid FEN: %s\n", shared->fen);
+		return 0;
+	}
+	for (int i = 0; i < shared->moveCount; i++)
+	{
+		NormalChessMove move;
+		if (!NormalChessParseMove(chess, shared->moveStrs[i], &move))
+		{
+			fprintf(stderr, "perft: illegal move: %s\n", shared->moveStrs[i]);
+			return 0;
+		}
+		NormalChessDoMove(chess, move);
+	}
+	return 1;
+}
+
+// Split the work up into jobs. There are only about 20-40 first moves, which is not enough to
+// keep many threads busy until the end, so for deeper counts each reply to a first move is a job.
+void PerftCreateJobs(PerftShared *shared, NormalChess *chess)
+{
+	shared->rootCount = NormalChessGenerateLegalMoves(chess, shared->rootMoves);
+	for (int i = 0; i < shared->rootCount; i++)
+	{
+		PerftJob job = { .root = i, .moveCount = 1, .moves = { shared->rootMoves[i] } };
+		if (shared->depth < 3)
+		{
+			arrput(shared->arrJobs, job);
+			continue;
+		}
+		NormalChessMove replies[NORMAL_CHESS_MAX_MOVES];
+		NormalChessUndo undo;
+		NormalChessMakeMove(chess, shared->rootMoves[i], &undo);
+		int replyCount = NormalChessGenerateLegalMoves(chess, replies);
+		NormalChessUnmakeMove(chess, shared->rootMoves[i], &undo);
+		job.moveCount = 2;
+		for (int j = 0; j < replyCount; j++)
+		{
+			job.moves[1] = replies[j];
+			arrput(shared->arrJobs, job);
+		}
+	}
+}
+
+// Thread function: take jobs until there are none left, and count the nodes for them.
+// Each thread has its own copy of the position.
+void *PerftThread(void *arg)
+{
+	PerftShared *shared = arg;
+	NormalChess position;
+	NormalChess *chess = &position;
+	PerftSetup(shared, chess);
+	for (;;)
+	{
+		int i = __atomic_fetch_add(&shared->nextJob, 1, __ATOMIC_RELAXED);
+		if (i >= arrlen(shared->arrJobs))
+		{
+			break;
+		}
+		const PerftJob *job = &shared->arrJobs[i];
+		NormalChessUndo undo[2];
+		for (int m = 0; m < job->moveCount; m++)
+		{
+			NormalChessMakeMove(chess, job->moves[m], &undo[m]);
+		}
+		long long nodes = Perft(shared, chess, shared->depth - job->moveCount);
+		for (int m = job->moveCount - 1; m >= 0; m--)
+		{
+			NormalChessUnmakeMove(chess, job->moves[m], &undo[m]);
+		}
+		__atomic_fetch_add(&shared->rootNodes[job->root], nodes, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+// Get the current time in seconds.
+double PerftSeconds(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2 || atoi(argv[1]) < 1)
+	{
+		fprintf(stderr, "usage: %s DEPTH [-d] [-f FEN] [-t THREADS] [-H MEGABYTES] [MOVE...]\n",
+				argv[0]);
+		return 1;
+	}
+	PerftShared shared = { .depth = atoi(argv[1]) };
+	int isDivide = 0;
+	int threadCount = 1;
+	int hashMegabytes = 0;
+	shared.moveStrs = malloc(argc * sizeof(*shared.moveStrs));
+	for (int i = 2; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-d"))
+		{
+			isDivide = 1;
+		}
+		else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+		{
+			shared.fen = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+		{
+			threadCount = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-H") && i + 1 < argc)
+		{
+			hashMegabytes = atoi(argv[++i]);
+		}
+		else
+		{
+			shared.moveStrs[shared.moveCount++] = argv[i];
+		}
+	}
+	if (threadCount < 1)
+	{
+		threadCount = 1;
+	}
+	if (hashMegabytes > 0)
+	{
+		// Use the biggest power of 2 number of slots that fits.
+		uint64_t slots = 1;
+		while (slots * 2 * sizeof(PerftHashEntry) <= (uint64_t)hashMegabytes << 20)
+		{
+			slots *= 2;
+		}
+		shared.hashTable = calloc(slots, sizeof(PerftHashEntry));
+		shared.hashMask = slots - 1;
+	}
+	BitboardInitTables();
+	NormalChessInitZobrist();
+	NormalChess chess;
+	if (!PerftSetup(&shared, &chess))
+	{
+		return 1;
+	}
+	PerftCreateJobs(&shared, &chess);
+	double start = PerftSeconds();
+	pthread_t *threads = malloc(threadCount * sizeof(*threads));
+	for (int i = 1; i < threadCount; i++)
+	{
+		pthread_create(&threads[i], NULL, PerftThread, &shared);
+	}
+	// The main thread does some of the work too.
+	PerftThread(&shared);
+	for (int i = 1; i < threadCount; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+	double seconds = PerftSeconds() - start;
+	long long nodes = 0;
+	for (int i = 0; i < shared.rootCount; i++)
+	{
+		if (isDivide)
+		{
+			char moveStr[6];
+			NormalChessMoveToString(shared.rootMoves[i], moveStr);
+			printf("%s: %lld\n", moveStr, shared.rootNodes[i]);
+		}
+		nodes += shared.rootNodes[i];
+	}
+	printf("perft %d = %lld\n", shared.depth, nodes);
+	printf("time: %.3f s, %.0f nodes/s\n", seconds, (seconds > 0)? nodes / seconds : 0.0);
+	free(threads);
+	free(shared.hashTable);
+	free(shared.moveStrs);
+	arrfree(shared.arrJobs);
+	return 0;
+}
+
+/* vi: set colorcolumn=101 textwidth=100 tabstop=4 noexpandtab: */